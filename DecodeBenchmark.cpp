@@ -0,0 +1,83 @@
+// Decoding benchmark: unserialization and dispatch of contracts to 'ON_SERIALIZATION_CONTRACT', in nanoseconds per message.
+//
+// g++ -std=c++17 -O2 -pthread DecodeBenchmark.cpp -o DecodeBenchmark
+// ./DecodeBenchmark [messages]
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SerializationContract.h"
+
+// Variant of 64 alternatives: 'std::array<char, 1>' ... 'std::array<char, 64>'.
+template <size_t ...I>
+std::variant<std::array<char, I + 1>...> MakeWideVariant(std::index_sequence<I...>);
+
+using WideVariant = decltype(MakeWideVariant(std::make_index_sequence<64>{}));
+
+template <size_t ...I>
+std::vector<WideVariant> MakeAlternatives(std::index_sequence<I...>) {
+  return { WideVariant(std::in_place_index<I>)... };
+}
+
+SERIALIZATION_CONTRACT(Wide, WideVariant);
+
+SERIALIZATION_CONTRACT(Order, int, std::string, double, std::vector<std::tuple<int, std::string>>);
+
+SERIALIZATION_CONTRACT(Tick, int, double, std::pair<char, bool>);
+
+// Dispatches 'messages' (which are repeated 'count' times), returns nanoseconds per message.
+static double Measure(const std::vector<std::vector<uint8_t>>& messages, size_t count) {
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < count; i++) {
+    PROCESS_SERIALIZATION_CONTRACT(messages[i % messages.size()]);
+  }
+
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? std::stoul(argv[1]) : 10000000;
+
+  size_t received = 0;
+
+  ON_SERIALIZATION_CONTRACT(Wide)[&](const WideVariant& par1)
+  {
+    received += par1.index();
+  };
+
+  ON_SERIALIZATION_CONTRACT(Order)[&](int, const std::string&, double, const std::vector<std::tuple<int, std::string>>& par4)
+  {
+    received += par4.size();
+  };
+
+  ON_SERIALIZATION_CONTRACT(Tick)[&](int par1, double, std::pair<char, bool>)
+  {
+    received += par1;
+  };
+
+  // Each alternative of the variant.
+  std::vector<std::vector<uint8_t>> wideMessages;
+
+  for (auto& alternative : MakeAlternatives(std::make_index_sequence<64>{})) {
+    Wide(alternative) >> wideMessages.emplace_back();
+  }
+
+  std::vector<std::vector<uint8_t>> orderMessages(1);
+  int id = 1;
+  std::string symbol = "SYM";
+  double price = 1.5;
+  std::vector<std::tuple<int, std::string>> fills = { {1, "A"}, {2, "B"}, {3, "C"} };
+  Order(id, symbol, price, fills) >> orderMessages[0];
+
+  std::vector<std::vector<uint8_t>> tickMessages(1);
+  std::pair<char, bool> side = { 'B', true };
+  Tick(id, price, side) >> tickMessages[0];
+
+  std::cout << "variant of 64 alternatives: " << Measure(wideMessages, count) << " ns/message\n";
+  std::cout << "order: " << Measure(orderMessages, count) << " ns/message\n";
+  std::cout << "fixed size tick: " << Measure(tickMessages, count) << " ns/message\n";
+
+  return received == 0;
+}
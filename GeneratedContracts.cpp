@@ -0,0 +1,66 @@
+// Compile time test: 256 generated contracts with 3 parameters each, all subscribed and dispatched.
+// The parameter types cycle through fixed size, string, vector, variant and map types.
+//
+// time g++ -std=c++17 -O2 -pthread GeneratedContracts.cpp -o GeneratedContracts
+// ./GeneratedContracts
+
+#include <iostream>
+#include <cassert>
+#include "SerializationContract.h"
+
+template <int N>
+using Param = std::tuple_element_t<N % 6, std::tuple<
+  int,
+  std::string,
+  std::vector<double>,
+  std::variant<int, std::string, std::array<char, N % 16 + 1>>,
+  std::map<int, std::string>,
+  std::pair<short, std::array<int, N % 8 + 1>>>>;
+
+#define GENERATED_CONTRACTS_16(M, a) \
+  M(a, 0) M(a, 1) M(a, 2) M(a, 3) M(a, 4) M(a, 5) M(a, 6) M(a, 7) M(a, 8) M(a, 9) M(a, A) M(a, B) M(a, C) M(a, D) M(a, E) M(a, F)
+
+#define GENERATED_CONTRACTS(M)                                                                          \
+  GENERATED_CONTRACTS_16(M, 0) GENERATED_CONTRACTS_16(M, 1) GENERATED_CONTRACTS_16(M, 2) GENERATED_CONTRACTS_16(M, 3) \
+  GENERATED_CONTRACTS_16(M, 4) GENERATED_CONTRACTS_16(M, 5) GENERATED_CONTRACTS_16(M, 6) GENERATED_CONTRACTS_16(M, 7) \
+  GENERATED_CONTRACTS_16(M, 8) GENERATED_CONTRACTS_16(M, 9) GENERATED_CONTRACTS_16(M, A) GENERATED_CONTRACTS_16(M, B) \
+  GENERATED_CONTRACTS_16(M, C) GENERATED_CONTRACTS_16(M, D) GENERATED_CONTRACTS_16(M, E) GENERATED_CONTRACTS_16(M, F)
+
+// Contract 'Contract<ab>' has parameters 'Param<0xab>', 'Param<0xab + 1>', 'Param<0xab + 2>'.
+#define DEFINE_CONTRACT(a, b) \
+  SERIALIZATION_CONTRACT(Contract##a##b, Param<0x##a##b>, Param<0x##a##b + 1>, Param<0x##a##b + 2>);
+
+#define SUBSCRIBE_CONTRACT(a, b)                                                                                        \
+  ON_SERIALIZATION_CONTRACT(Contract##a##b)[&](const Param<0x##a##b>&, const Param<0x##a##b + 1>&, const Param<0x##a##b + 2>&) \
+  {                                                                                                                     \
+    received += 0x##a##b;                                                                                               \
+  };
+
+#define SEND_CONTRACT(a, b)                                              \
+  {                                                                      \
+    Param<0x##a##b> par1 {};                                             \
+    Param<0x##a##b + 1> par2 {};                                         \
+    Param<0x##a##b + 2> par3 {};                                         \
+    Contract##a##b(par1, par2, par3) >> bytes;                           \
+                                                                         \
+    bool processed = PROCESS_SERIALIZATION_CONTRACT(bytes);              \
+    dispatched += processed;                                             \
+  }
+
+GENERATED_CONTRACTS(DEFINE_CONTRACT)
+
+int main(int, char**) {
+  size_t received = 0;
+  size_t dispatched = 0;
+
+  GENERATED_CONTRACTS(SUBSCRIBE_CONTRACT)
+
+  std::vector<uint8_t> bytes;
+
+  GENERATED_CONTRACTS(SEND_CONTRACT)
+
+  // Each contract is dispatched to its own subscriber: 0 + 1 + ... + 255.
+  assert(dispatched == 256 && received == 255 * 256 / 2);
+
+  std::cout << "!!!\n";
+}
@@ -2,6 +2,13 @@
 #include <cassert>
 #include "SerializationContract.h"
 
+#ifdef __linux__
+#include "SerializationContractShm.h"
+#include "SerializationContractSocket.h"
+#include "SerializationContractRecord.h"
+#include <sys/wait.h>
+#endif
+
 using namespace std;
 
 // Example of a custom struct 'Data' and its implementation of serialization and unserialization.
@@ -30,6 +37,23 @@ SERIALIZATION_CONTRACT(QAZ, std::optional<std::vector<std::string>>, std::option
 
 SERIALIZATION_CONTRACT(ZXC, std::shared_ptr<std::string>);
 
+SERIALIZATION_CONTRACT(TGB, int, std::string);
+
+SERIALIZATION_CONTRACT(WSX, std::vector<std::map<int, int>>);
+
+SERIALIZATION_CONTRACT(YHN, std::vector<std::pair<std::optional<int>, std::optional<int>>>);
+
+// Serialization contract 'EDC' with only fixed size parameters, its encoded size is known at compile time.
+SERIALIZATION_CONTRACT(EDC, int, std::array<double, 2>, std::pair<char, bool>);
+
+// Serialization contract 'RFV' with a variant of 64 alternatives: 'std::array<char, 1>' ... 'std::array<char, 64>'.
+template <size_t ...I>
+std::variant<std::array<char, I + 1>...> MakeWideVariant(std::index_sequence<I...>);
+
+using WideVariant = decltype(MakeWideVariant(std::make_index_sequence<64>{}));
+
+SERIALIZATION_CONTRACT(RFV, WideVariant);
+
 int main(int, char**) {
   std::vector<uint8_t> bytes;
 
@@ -61,6 +85,89 @@ int main(int, char**) {
   assert(qazOut1 == qazIn1 && qazOut2 == qazIn2);
 
 
+  // Test EDC, serialized in 'std::array' without heap allocation.
+  int edcIn1 = 5;
+  std::array<double, 2> edcIn2 = { 1.5, 2.5 };
+  std::pair<char, bool> edcIn3 = { 'E', true };
+  decltype(EDC)::FixedBytes edcBytes;
+  EDC(edcIn1, edcIn2, edcIn3) >> edcBytes;
+
+  decltype(edcIn1) edcOut1;
+  decltype(edcIn2) edcOut2;
+  decltype(edcIn3) edcOut3;
+  EDC(edcOut1, edcOut2, edcOut3) << edcBytes;
+
+  // Compare In and Out of 'EDC' contract data.
+  assert(edcOut1 == edcIn1 && edcOut2 == edcIn2 && edcOut3 == edcIn3);
+
+
+  // Test RFV, with the first and the last alternatives of the variant.
+  WideVariant rfvIn1 = std::array<char, 1>{ 'R' };
+  WideVariant rfvIn2 = std::array<char, 64>{ 'R', 'F', 'V' };
+
+  WideVariant rfvOut1;
+  RFV(rfvIn1) >> bytes;
+  RFV(rfvOut1) << bytes;
+
+  WideVariant rfvOut2;
+  RFV(rfvIn2) >> bytes;
+  RFV(rfvOut2) << bytes;
+
+  // Compare In and Out of 'RFV' contract data.
+  assert(rfvOut1 == rfvIn1 && rfvOut2 == rfvIn2 && rfvOut2.index() == 63);
+
+  // An index out of range of the alternatives (the index follows the contract name) is rejected.
+  size_t rfvIndex = 64;
+  memcpy(bytes.data() + sizeof(size_t) + strlen("RFV"), &rfvIndex, sizeof(rfvIndex));
+
+  bool rfvUnserialized = true;
+
+  try {
+    RFV(rfvOut2) << bytes;
+  } catch (const SerializationContract::UnserializeError&) {
+    rfvUnserialized = false;
+  }
+
+  assert(!rfvUnserialized);
+
+
+  // Test XYZ, its vector is encoded and decoded in chunks on 4 threads (vectors with at least 16 elements).
+  SerializationContract::Parallel() = { 4, 16 };
+
+  std::vector<std::tuple<int, std::string>> parallelIn1;
+  for (int i = 0; i < 1000; i++) {
+    parallelIn1.emplace_back(i, std::to_string(i));
+  }
+
+  std::map<int, Data> parallelIn2 = { {1, {L"XYZ"}} };
+  XYZ(parallelIn1, parallelIn2) >> bytes;
+
+  decltype(parallelIn1) parallelOut1;
+  decltype(parallelIn2) parallelOut2;
+  XYZ(parallelOut1, parallelOut2) << bytes;
+
+  // Compare In and Out of 'XYZ' contract data.
+  assert(parallelOut1 == parallelIn1 && parallelOut2 == parallelIn2);
+
+  // Test XYZ, its vector of tuples is encoded by columns in each parallel chunk.
+  SerializationContract::Columnar().enabled = true;
+
+  XYZ(parallelIn1, parallelIn2) >> bytes;
+  XYZ(parallelOut1, parallelOut2) << bytes;
+
+  assert(parallelOut1 == parallelIn1 && parallelOut2 == parallelIn2);
+
+  SerializationContract::Parallel() = {};
+
+  // Test XYZ, its vector of tuples is encoded by columns.
+  XYZ(parallelIn1, parallelIn2) >> bytes;
+  XYZ(parallelOut1, parallelOut2) << bytes;
+
+  SerializationContract::Columnar().enabled = false;
+
+  assert(parallelOut1 == parallelIn1 && parallelOut2 == parallelIn2);
+
+
   //
   // Example of serializing data on client, after receiving 'bytes' on server, 
   // invoking corresponding contract unserialization callback.
@@ -75,6 +182,13 @@ int main(int, char**) {
     xyzOut2 = par2;
   };
 
+  // Second subscriber to 'XYZ', receives the same unserialized data.
+  size_t xyzCount = 0;
+  ON_SERIALIZATION_CONTRACT(XYZ)[&](const std::vector<std::tuple<int, std::string>>& par1, const std::map<int, Data>&)
+  {
+    xyzCount = par1.size();
+  };
+
   std::variant<int, float, std::variant<int, std::string>> abcOut;
   ON_SERIALIZATION_CONTRACT(ABC)[&](const auto& par1)
   {
@@ -92,7 +206,38 @@ int main(int, char**) {
   bool processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
 
   // Compare client and server 'XYZ' data.
-  assert(processed && xyzOut1 == xyzIn1 && xyzOut2 == xyzIn2);
+  assert(processed && xyzOut1 == xyzIn1 && xyzOut2 == xyzIn2 && xyzCount == xyzIn1.size());
+
+  // Truncated 'bytes' are rejected, 'PROCESS_SERIALIZATION_CONTRACT' returns 'false'.
+  bytes.resize(bytes.size() - 1);
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(!processed);
+
+  // An element count larger than the encoded bytes is rejected before allocation:
+  // 'WSX' with a vector of 2^40 maps in one chunk of 0 bytes.
+  ON_SERIALIZATION_CONTRACT(WSX)[&](const std::vector<std::map<int, int>>&)
+  {
+  };
+
+  SerializationContract::Serializer wsxSerializer(bytes);
+  wsxSerializer << std::string("WSX") << (SerializationContract::ChunkedSizeFlag | size_t(1) << 40) << size_t(1) << size_t(0);
+
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(!processed);
+
+  // 'YHN' with a columnar vector of 2^40 pairs, and no columns.
+  ON_SERIALIZATION_CONTRACT(YHN)[&](const std::vector<std::pair<std::optional<int>, std::optional<int>>>&)
+  {
+  };
+
+  SerializationContract::Serializer yhnSerializer(bytes);
+  yhnSerializer << std::string("YHN") << (SerializationContract::ColumnarSizeFlag | size_t(1) << 40);
+
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(!processed);
 
   // Client code, 'ABC' contract creates 'bytes'.
   std::variant<int, float, std::variant<int, std::string>> abcIn = "ABC";
@@ -104,6 +249,29 @@ int main(int, char**) {
   // Compare client and server 'ABC' data.
   assert(processed && abcOut == abcIn);
 
+  // With the checksum, 'bytes' are followed by their CRC32C, which is verified before unserialization.
+  SerializationContract::Checksum().enabled = true;
+
+  ABC(abcIn) >> bytes;
+
+  abcOut = 0;
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(processed && abcOut == abcIn);
+
+  // A corrupted byte is detected, the contract is not processed.
+  bytes[bytes.size() / 2] ^= 1;
+
+  abcOut = 0;
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  decltype(abcIn) abcCorrupted;
+  bool unserialized = ABC(abcCorrupted) << bytes;
+
+  SerializationContract::Checksum().enabled = false;
+
+  assert(!processed && !unserialized && abcOut == decltype(abcOut)(0));
+
   // Client code, 'QAZ' contract creates 'bytes'.
   QAZ(qazIn1, qazIn2) >> bytes;
 
@@ -112,5 +280,256 @@ int main(int, char**) {
 
   assert(!processed);
 
+  // Server code, subscribing to 'TGB' with filters of its first parameter.
+  std::string tgbPositive;
+  ON_SERIALIZATION_CONTRACT_IF(TGB, [](int par1) { return par1 > 0; })[&](int, const std::string& par2)
+  {
+    tgbPositive = par2;
+  };
+
+  std::string tgbEven;
+  ON_SERIALIZATION_CONTRACT_IF(TGB, [](int par1) { return par1 % 2 == 0; })[&](int, const std::string& par2)
+  {
+    tgbEven = par2;
+  };
+
+  // Only the first filter accepts 1.
+  int tgbIn1 = 1;
+  std::string tgbIn2 = "TGB1";
+  TGB(tgbIn1, tgbIn2) >> bytes;
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(processed && tgbPositive == "TGB1" && tgbEven.empty());
+
+  // Only the second filter accepts -2.
+  tgbIn1 = -2;
+  tgbIn2 = "TGB2";
+  TGB(tgbIn1, tgbIn2) >> bytes;
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(processed && tgbPositive == "TGB1" && tgbEven == "TGB2");
+
+  // No filter accepts -1, the contract is dropped and 'PROCESS_SERIALIZATION_CONTRACT' returns 'false'.
+  tgbIn1 = -1;
+  tgbIn2 = "TGB3";
+  TGB(tgbIn1, tgbIn2) >> bytes;
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  assert(!processed && tgbPositive == "TGB1" && tgbEven == "TGB2");
+
+  // The subscribers of 'XYZ' are called on 2 threads.
+  SerializationContract::UnserializeDispatcher::Instance().SetSubscriberThreads(2);
+
+  xyzOut1.clear();
+  xyzCount = 0;
+
+  XYZ(xyzIn1, xyzIn2) >> bytes;
+  processed = PROCESS_SERIALIZATION_CONTRACT(bytes);
+
+  SerializationContract::UnserializeDispatcher::Instance().SetSubscriberThreads(1);
+
+  assert(processed && xyzOut1 == xyzIn1 && xyzCount == xyzIn1.size());
+
+  // The number of subscriber threads can be changed while contracts are dispatched on another thread.
+  std::atomic<size_t> concurrentCount = 0;
+
+  std::thread dispatchThread([&]() {
+    std::vector<uint8_t> threadBytes;
+    XYZ(xyzIn1, xyzIn2) >> threadBytes;
+
+    for (int i = 0; i < 1000; i++) {
+      PROCESS_SERIALIZATION_CONTRACT(threadBytes);
+      concurrentCount++;
+    }
+  });
+
+  for (unsigned threads = 1; concurrentCount < 1000; threads = threads % 4 + 1) {
+    SerializationContract::UnserializeDispatcher::Instance().SetSubscriberThreads(threads);
+  }
+
+  dispatchThread.join();
+
+  SerializationContract::UnserializeDispatcher::Instance().SetSubscriberThreads(1);
+
+#ifdef __linux__
+  //
+  // Example of sending contracts from a child process through a shared memory ring.
+  //
+  auto ring = SerializationContract::ShmRingSPSC::Create(8, 1024);
+
+  constexpr int ShmMessages = 100;
+
+  if (fork() == 0) {
+    // Client process.
+    for (int i = 0; i < ShmMessages; i++) {
+      std::vector<std::tuple<int, std::string>> par1 = { {i, "SHM"} };
+      ring.Push(XYZ(par1, xyzIn2));
+    }
+
+    // A contract larger than the slot is published as an empty message.
+    std::vector<std::tuple<int, std::string>> par1 = { {0, std::string(1024, 'x')} };
+
+    try {
+      ring.Push(XYZ(par1, xyzIn2));
+    } catch (const std::length_error&) {
+      _exit(0);
+    }
+
+    _exit(1);
+  }
+
+  // Server process, messages arrive in order.
+  bool shmInOrder = true;
+
+  for (int i = 0; i < ShmMessages; i++) {
+    processed = ring.Dispatch();
+
+    shmInOrder = shmInOrder && processed && xyzOut1.size() == 1 && std::get<0>(xyzOut1[0]) == i && xyzOut2 == xyzIn2;
+  }
+
+  processed = ring.Dispatch();
+
+  int status;
+  wait(&status);
+
+  assert(shmInOrder && !processed && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  // The slot is released if the consumer's callback throws.
+  std::vector<std::tuple<int, std::string>> shmPar1 = { {1, "SHM"} };
+  ring.Push(XYZ(shmPar1, xyzIn2));
+
+  try {
+    ring.TryPop([](const uint8_t*, size_t) { throw std::runtime_error("callback"); });
+  } catch (const std::runtime_error&) {
+  }
+
+  bool popped = ring.TryPop([](const uint8_t*, size_t) {});
+
+  ring.Push(XYZ(shmPar1, xyzIn2));
+  processed = ring.Dispatch();
+
+  assert(!popped && processed);
+
+  // A ring whose slots don't fit in its size is not attached.
+  auto truncatedRing = SerializationContract::ShmRingSPSC::Create(8, 1024);
+  bool attached = ftruncate(truncatedRing.Fd(), 4096) != 0;
+
+  try {
+    SerializationContract::ShmRingSPSC::Attach(truncatedRing.Fd());
+    attached = true;
+  } catch (const std::invalid_argument&) {
+  }
+
+  assert(!attached);
+
+  //
+  // Example of sending contracts through a Unix-domain socket.
+  //
+  auto socketPath = "/tmp/SerializationContract." + std::to_string(getpid()) + ".sock";
+
+  SerializationContract::UnixSocketServer server(socketPath);
+  SerializationContract::UnixSocketClient client(socketPath);
+
+  // Client code, the batch is sent by 'Flush'.
+  client.Send(XYZ(xyzIn1, xyzIn2));
+  client.Send(ABC(abcIn));
+  client.Flush();
+
+  xyzOut1.clear();
+  abcOut = 0;
+
+  // Server code, accepts the connection and dispatches both messages.
+  size_t socketDispatched = 0;
+
+  for (int i = 0; i < 100 && socketDispatched < 2; i++) {
+    socketDispatched += server.RunOnce(100);
+  }
+
+  assert(socketDispatched == 2 && xyzOut1 == xyzIn1 && abcOut == abcIn);
+
+  // A message larger than 'MaxFrameSize' is not sent.
+  std::vector<std::tuple<int, std::string>> socketPar1 = { {0, std::string(SerializationContract::UnixSocketServer::MaxFrameSize, 'x')} };
+  bool sent = true;
+
+  try {
+    client.Send(XYZ(socketPar1, xyzIn2));
+  } catch (const std::length_error&) {
+    sent = false;
+  }
+
+  assert(!sent);
+
+  //
+  // Example of recording contracts to a capture file, and replaying them.
+  //
+  auto capturePath = "/tmp/SerializationContract." + std::to_string(getpid()) + ".cap";
+
+  {
+    SerializationContract::ContractRecorder recorder(capturePath);
+
+    XYZ(xyzIn1, xyzIn2) >> bytes;
+    recorder.Record(bytes);
+
+    ABC(abcIn) >> bytes;
+    recorder.Record(bytes);
+
+    XYZ(xyzIn1, xyzIn2) >> bytes;
+    recorder.Record(bytes);
+  }
+
+  {
+    SerializationContract::ContractReplay replay(capturePath);
+
+    // Positions of 'XYZ' messages, and of those from position 1.
+    assert(replay.Count() == 3);
+    assert(replay.Find("XYZ") == std::vector<size_t>({ 0, 2 }) && replay.Find("XYZ", 1) == std::vector<size_t>({ 2 }));
+    assert(replay.Find("QAZ").empty());
+
+    xyzOut1.clear();
+    abcOut = 0;
+
+    auto replayed = replay.Replay();
+
+    assert(replayed == 3 && xyzOut1 == xyzIn1 && abcOut == abcIn);
+  }
+
+  // A recorder which crashed during a flush: a complete 'ABC' record is not in the index,
+  // and the capture, index and postings files end with partially written data.
+  auto appendToFile = [](const std::string& path, const void* data, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+    bool written = fd >= 0 && write(fd, data, size) == (ssize_t)size;
+    close(fd);
+
+    return written;
+  };
+
+  ABC(abcIn) >> bytes;
+  SerializationContract::CaptureRecordHeader recordHeader = { SerializationContract::CaptureTimestamp(), bytes.size() };
+
+  char partial[10] = {};
+  bool crashed = appendToFile(capturePath, &recordHeader, sizeof(recordHeader)) && appendToFile(capturePath, bytes.data(), bytes.size()) &&
+                 appendToFile(capturePath, partial, sizeof(partial)) && appendToFile(capturePath + ".index", partial, sizeof(partial)) &&
+                 appendToFile(capturePath + ".postings", partial, sizeof(partial));
+
+  // The files are repaired when the recorder opens them.
+  {
+    SerializationContract::ContractRecorder recorder(capturePath);
+
+    QAZ(qazIn1, qazIn2) >> bytes;
+    recorder.Record(bytes);
+  }
+
+  {
+    SerializationContract::ContractReplay replay(capturePath);
+
+    assert(crashed && replay.Count() == 5);
+    assert(replay.Find("ABC") == std::vector<size_t>({ 1, 3 }) && replay.Find("QAZ") == std::vector<size_t>({ 4 }));
+  }
+
+  for (auto suffix : { "", ".index", ".postings" }) {
+    unlink((capturePath + suffix).c_str());
+  }
+#endif
+
   std::cout << "!!!\n";
 }
@@ -3,6 +3,9 @@
 #pragma once 
 
 #include "SerializationContractData.h"
+#include "SerializationContractChecksum.h"
+
+#include <stdexcept>
 
 namespace SerializationContract {
   //
@@ -13,6 +16,18 @@ namespace SerializationContract {
 
   template <const char* Name, typename... Params>
   struct Processor<Name, std::function<void(Params...)>> {
+    // A contract with only fixed size parameters has a compile time encoded size, the name and the parameters
+    // are written and read at fixed offsets.
+    static constexpr size_t NameSize = std::char_traits<char>::length(Name);
+
+    using FixedParams = FixedSize<std::tuple<std::decay_t<Params>...>>;
+
+    static constexpr bool IsFixedSize = FixedParams::value;
+
+    static constexpr size_t FixedEncodedSize = sizeof(size_t) + NameSize + FixedParams::Size;
+
+    using FixedBytes = std::array<uint8_t, FixedEncodedSize>;
+
     template <typename IsConstParams, typename ...Ts>
     auto CreateTupleWithParamsProxy(Ts&&... ts) {
       auto tuple = std::tuple<Ts&...>(std::forward<Ts&>(ts)...);
@@ -31,47 +46,92 @@ namespace SerializationContract {
 
     template <typename IsConstParams, typename TupleWithParams>
     struct TupleWithParamsProxy {
-      static constexpr auto LastTupleIndex = std::tuple_size_v<TupleWithParams> -1;
-
       // Serialization        
       void operator >> (std::vector<uint8_t>& bytes) {
         Serializer serializer(bytes);
-        SerializeParams<0>(serializer);
+        *this >> serializer;
+      }
+
+      // Serialization to 'serializer', e.g. in place to a buffer with 'Serializer(data, capacity)'.
+      // Throws 'std::length_error' if the buffer is too small.
+      void operator >> (Serializer& serializer) {
+        auto offset = serializer.Size();
+
+        if constexpr (IsFixedSize) {
+          if (auto data = serializer.Extend(FixedEncodedSize)) {
+            SerializeFixed(data);
+          }
+        } else {
+          SerializeParams(serializer);
+        }
+
+        if (Checksum().enabled) {
+          auto data = serializer.Data();
+          serializer.Serialize(data ? ComputeChecksum(data + offset, serializer.Size() - offset) : checksum_t(0));
+        }
+      }
+
+      // Serialization of a fixed size contract, without heap allocation.
+      void operator >> (FixedBytes& bytes) {
+        static_assert(IsFixedSize, "The contract has parameters which are not fixed size");
+
+        SerializeFixed(bytes.data());
+      }
+
+      void SerializeFixed(uint8_t* data) {
+        size_t nameSize = NameSize;
+        memcpy(data, &nameSize, sizeof(nameSize));
+        memcpy(data + sizeof(nameSize), Name, NameSize);
+
+        FixedParams::Write(data + sizeof(nameSize) + NameSize, tupleWithParams_);
       }
 
-      template<int Index>
       void SerializeParams(Serializer& serializer) {
-        if constexpr (Index == 0) {
-          serializer << std::string(Name);
+        serializer << std::string(Name);
+
+        std::apply([&](const auto&... params) { (serializer << ... << params); }, tupleWithParams_);
+      }
+
+      // Unserialization, returns 'false' if the checksum doesn't match.
+      // Throws 'UnserializeError' if 'bytes' are shorter than the encoded parameters.
+      bool operator << (const std::vector<uint8_t>& bytes) {
+        static_assert(std::is_same_v<IsConstParams, std::false_type>, "Cannot unserialize to const");
+
+        auto size = bytes.size();
+
+        if (Checksum().enabled && !VerifyChecksum(bytes.data(), size)) {
+          return false;
         }
 
-        serializer << std::get<Index>(tupleWithParams_);
+        Unserializer unserializer(bytes.data(), size);
 
-        if constexpr (Index < LastTupleIndex) {
-          SerializeParams<Index + 1>(serializer);
+        if constexpr (IsFixedSize) {
+          UnserializeFixed(unserializer.Take(FixedEncodedSize));
+        } else {
+          UnserializeParams(unserializer);
         }
+
+        return true;
       }
 
-      // Unserialization
-      void operator << (const std::vector<uint8_t>& bytes) {
+      bool operator << (const FixedBytes& bytes) {
         static_assert(std::is_same_v<IsConstParams, std::false_type>, "Cannot unserialize to const");
+        static_assert(IsFixedSize, "The contract has parameters which are not fixed size");
+
+        UnserializeFixed(bytes.data());
 
-        Unserializer unserializer(bytes);
-        UnserializeParams<0>(unserializer);
+        return true;
       }
 
-      template<int Index>
-      void UnserializeParams(Unserializer& unserializer) {
-        if constexpr (Index == 0) {
-          std::string name;
-          unserializer >> name;
-        }
+      void UnserializeFixed(const uint8_t* data) {
+        FixedParams::Read(data + sizeof(size_t) + NameSize, tupleWithParams_);
+      }
 
-        unserializer >> std::get<Index>(tupleWithParams_);
+      void UnserializeParams(Unserializer& unserializer) {
+        std::string name;
+        unserializer >> name;
 
-        if constexpr (Index < LastTupleIndex) {
-          UnserializeParams<Index + 1>(unserializer);
-        }
+        std::apply([&](auto&... params) { (unserializer >> ... >> params); }, tupleWithParams_);
       }
 
       TupleWithParams tupleWithParams_;
@@ -81,6 +141,10 @@ namespace SerializationContract {
   //
   // UnserializeDispatcher
   //
+  // All subscribers to a contract receive the same arguments, which are unserialized once.
+  // A subscriber's filter receives the first parameter, which is unserialized before the rest,
+  // and if no subscriber accepts it, the rest are not unserialized, and the contract is dropped.
+  //
   class UnserializeDispatcher {
   public:
     static UnserializeDispatcher& Instance() {
@@ -89,72 +153,185 @@ namespace SerializationContract {
     }
 
     struct IDispatcher {
+      IDispatcher(const void* tag) : tag_(tag) {}
+
       virtual ~IDispatcher() = default;
 
-      virtual bool Dispatch(const std::string& contractName, Unserializer& unserializer) = 0;
+      // Returns 'false' if no subscriber accepted the contract.
+      virtual bool Dispatch(Unserializer& unserializer, ThreadPool* pThreadPool) = 0;
+
+      // Identifies the parameter types of the dispatcher, see 'TDispatcher::Tag'.
+      const void* tag_;
     };
 
-    template <typename F, const char* Name, typename... Params>
+    template <typename... Params>
     class TDispatcher : public IDispatcher {
     public:
-      TDispatcher(F f)
-        : f_(f)
-      {}
-
-      template <typename ...> struct ArgsCollector;
-
-      template <typename T, typename ...Ts>
-      struct ArgsCollector<T, Ts...> {
-        template <typename ...Args>
-        static void CollectArgs(F f, Unserializer& unserializer, const Args&...args) {
-          T arg;
-          unserializer >> arg;
-
-          if constexpr (0 == sizeof...(Ts)) {
-            f(args..., (const T&)arg);
-          } else {
-            ArgsCollector<Ts...>::template CollectArgs<>(f, unserializer, args..., arg);
+      using FirstParam = std::tuple_element_t<0, std::tuple<Params...>>;
+
+      using Filter = std::function<bool(const FirstParam&)>;
+
+      // Unique address for each 'Params...', without RTTI.
+      static const void* Tag() {
+        static char s_tag;
+        return &s_tag;
+      }
+
+      TDispatcher() : IDispatcher(Tag()) {}
+
+      void Subscribe(std::function<void(const Params&...)> f, Filter filter) {
+        hasFilters_ = hasFilters_ || filter;
+
+        subscribers_.push_back({ std::move(f), std::move(filter) });
+      }
+
+      bool Dispatch(Unserializer& unserializer, ThreadPool* pThreadPool) override {
+        using FixedParams = FixedSize<std::tuple<std::decay_t<Params>...>>;
+
+        std::tuple<Params...> args;
+
+        if constexpr (FixedParams::value) {
+          FixedParams::Read(unserializer.Take(FixedParams::Size), args);
+        } else {
+          unserializer >> std::get<0>(args);
+        }
+
+        // Empty if there are no filters.
+        std::vector<bool> accepted;
+
+        if (hasFilters_) {
+          accepted.resize(subscribers_.size());
+
+          for (size_t i = 0; i < subscribers_.size(); i++) {
+            accepted[i] = !subscribers_[i].filter || subscribers_[i].filter(std::get<0>(args));
+          }
+
+          if (std::find(accepted.begin(), accepted.end(), true) == accepted.end()) {
+            return false;
           }
         }
-      };
 
-      bool Dispatch(const std::string& contractName, Unserializer& unserializer) override {
-        if (contractName != Name) {
-          return false;
+        if constexpr (!FixedParams::value) {
+          UnserializeRest(unserializer, args, std::make_index_sequence<sizeof...(Params) - 1>{});
         }
 
-        ArgsCollector<Params...>::template CollectArgs<>(f_, unserializer);
+        auto call = [&](size_t i) {
+          if (accepted.empty() || accepted[i]) {
+            std::apply(subscribers_[i].f, args);
+          }
+        };
+
+        if (pThreadPool && subscribers_.size() > 1) {
+          pThreadPool->Run(subscribers_.size(), call);
+        } else {
+          for (size_t i = 0; i < subscribers_.size(); i++) {
+            call(i);
+          }
+        }
 
         return true;
       }
 
-      F f_;
+    private:
+      template <size_t... I>
+      static void UnserializeRest(Unserializer& unserializer, std::tuple<Params...>& args, std::index_sequence<I...>) {
+        ((unserializer >> std::get<I + 1>(args)), ...);
+      }
+
+      struct Subscriber {
+        std::function<void(const Params&...)> f;
+        Filter filter;
+      };
+
+      std::vector<Subscriber> subscribers_;
+      bool hasFilters_ = false;
     };
 
-    bool Dispatch(const std::vector<uint8_t>& bytes) {
-      Unserializer unserializer(bytes);
+    // Subscribers to the same contract are called on 'threads' threads (including the dispatching thread).
+    // It can be called while contracts are dispatched, a dispatch which has already started keeps the previous pool.
+    void SetSubscriberThreads(unsigned threads) {
+      auto pThreadPool = threads > 1 ? std::make_shared<ThreadPool>(threads) : nullptr;
 
-      std::string contractName;
-      unserializer >> contractName;
+      // The previous pool is destroyed after the lock is released, or when its last dispatch ends.
+      {
+        std::lock_guard<std::mutex> lock(threadPoolMutex_);
 
-      bool dispatched = false;
+        std::swap(pThreadPool_, pThreadPool);
+        hasThreadPool_.store(pThreadPool_ != nullptr, std::memory_order_release);
+      }
+    }
 
-      for (const auto& pDispatcher : vDispatcher_) {
-        if (pDispatcher->Dispatch(contractName, unserializer)) {
-          dispatched = true;
-          break;
-        }
+    bool Dispatch(const std::vector<uint8_t>& bytes) {
+      return Dispatch(bytes.data(), bytes.size());
+    }
+
+    // Fixed size contracts don't have a checksum.
+    template <size_t N>
+    bool Dispatch(const std::array<uint8_t, N>& bytes) {
+      return DispatchUnchecked(bytes.data(), bytes.size());
+    }
+
+    // Returns 'true' if the contract was delivered to a subscriber, and 'false' if the checksum doesn't match, the bytes are malformed,
+    // there is no subscription to the contract, or all subscribers' filters rejected it.
+    bool Dispatch(const uint8_t* data, size_t size) {
+      if (Checksum().enabled && !VerifyChecksum(data, size)) {
+        return false;
       }
 
-      return dispatched;
+      return DispatchUnchecked(data, size);
     }
 
     template <const char* Name, typename... Params, typename F>
-    void Subscribe(const Processor<Name, std::function<void(Params...)>>&, F f) {
-      vDispatcher_.emplace_back(std::make_unique<TDispatcher<F, Name, Params...>>(f));
+    void Subscribe(const Processor<Name, std::function<void(Params...)>>&, F f,
+                   typename TDispatcher<Params...>::Filter filter = nullptr) {
+      auto& pDispatcher = dispatchers_[Name];
+
+      if (!pDispatcher) {
+        pDispatcher = std::make_unique<TDispatcher<Params...>>();
+      }
+
+      // A contract with the same name, and different parameters, is already subscribed (e.g. in another translation unit).
+      if (pDispatcher->tag_ != TDispatcher<Params...>::Tag()) {
+        throw std::logic_error(std::string("Contract '") + Name + "' is subscribed with different parameters");
+      }
+
+      static_cast<TDispatcher<Params...>*>(pDispatcher.get())->Subscribe(f, std::move(filter));
     }
 
-    std::vector<std::unique_ptr<IDispatcher>> vDispatcher_;
+  private:
+    // Dispatches without the checksum verification.
+    bool DispatchUnchecked(const uint8_t* data, size_t size) {
+      try {
+        Unserializer unserializer(data, size);
+
+        std::string contractName;
+        unserializer >> contractName;
+
+        auto it = dispatchers_.find(contractName);
+        if (it == dispatchers_.end()) {
+          return false;
+        }
+
+        return it->second->Dispatch(unserializer, ThreadPoolOfDispatch().get());
+      } catch (const UnserializeError&) {
+        return false;
+      }
+    }
+
+    // The mutex is locked only when there is a pool.
+    std::shared_ptr<ThreadPool> ThreadPoolOfDispatch() {
+      if (!hasThreadPool_.load(std::memory_order_acquire)) {
+        return nullptr;
+      }
+
+      std::lock_guard<std::mutex> lock(threadPoolMutex_);
+      return pThreadPool_;
+    }
+
+    std::unordered_map<std::string, std::unique_ptr<IDispatcher>> dispatchers_;
+    std::shared_ptr<ThreadPool> pThreadPool_;
+    std::atomic<bool> hasThreadPool_ = false;
+    std::mutex threadPoolMutex_;
   };
 
   //
@@ -163,27 +340,37 @@ namespace SerializationContract {
   template <const char* Name, typename... Params>
   class UnserializeDispatcherProxy {
   public:
-    UnserializeDispatcherProxy(const Processor<Name, std::function<void(Params...)>>& processor)
-      : processor_(processor)
+    using Filter = typename UnserializeDispatcher::TDispatcher<Params...>::Filter;
+
+    UnserializeDispatcherProxy(const Processor<Name, std::function<void(Params...)>>& processor, Filter filter = nullptr)
+      : processor_(processor), filter_(std::move(filter))
     {}
 
     template <typename F>
     bool operator = (F f)
     {
-      UnserializeDispatcher::Instance().Subscribe(processor_, f);
+      UnserializeDispatcher::Instance().Subscribe(processor_, f, filter_);
       return true;
     }
 
     Processor<Name, std::function<void(Params...)>> processor_;
+    Filter filter_;
   };
 }
 
+#define SERIALIZATION_CONTRACT_CONCAT_(x, y) x##y
+#define SERIALIZATION_CONTRACT_CONCAT(x, y) SERIALIZATION_CONTRACT_CONCAT_(x, y)
+
 #define SERIALIZATION_CONTRACT(x, ...)                                                                                      \
   [[maybe_unused]] inline static constexpr char s_contractName##x[] = #x;                                                   \
   [[maybe_unused]] static auto x = SerializationContract::Processor<s_contractName##x, std::function<void(__VA_ARGS__)>>(); \
 
 #define ON_SERIALIZATION_CONTRACT(x) \
-    [[maybe_unused]] static bool s_onContract##x = SerializationContract::UnserializeDispatcherProxy(x) = 
+    [[maybe_unused]] static bool SERIALIZATION_CONTRACT_CONCAT(s_onContract##x, __LINE__) = SerializationContract::UnserializeDispatcherProxy(x) = 
+
+// 'filter' receives the first parameter of the contract, the callback is called if it returns 'true'.
+#define ON_SERIALIZATION_CONTRACT_IF(x, filter) \
+    [[maybe_unused]] static bool SERIALIZATION_CONTRACT_CONCAT(s_onContract##x, __LINE__) = SerializationContract::UnserializeDispatcherProxy(x, filter) = 
 
 #define PROCESS_SERIALIZATION_CONTRACT(bytes) \
   SerializationContract::UnserializeDispatcher::Instance().Dispatch(bytes);
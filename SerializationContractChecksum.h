@@ -0,0 +1,197 @@
+// CRC32C checksum of contract frames: SSE4.2 'crc32' with PCLMUL combining of parallel streams, or a table fallback.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SERIALIZATION_CONTRACT_CRC32C_X86
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace SerializationContract {
+  //
+  // Checksum
+  //
+  // When enabled, a serialized contract is followed by CRC32C of its bytes, which is verified before unserialization.
+  // It should be enabled on both sides. Contracts serialized in 'FixedBytes' don't have a checksum.
+  //
+  struct ChecksumOptions {
+    bool enabled = false;
+  };
+
+  inline ChecksumOptions& Checksum() {
+    static ChecksumOptions s_options;
+    return s_options;
+  }
+
+  using checksum_t = uint32_t;
+
+  namespace Crc32c {
+    // Reflected Castagnoli polynomial.
+    constexpr uint32_t Polynomial = 0x82F63B78;
+
+    // Slicing-by-8 tables, 'Tables[k][b]' is CRC of byte 'b' followed by 'k' zero bytes.
+    constexpr std::array<std::array<uint32_t, 256>, 8> MakeTables() {
+      std::array<std::array<uint32_t, 256>, 8> tables = {};
+
+      for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+
+        for (int i = 0; i < 8; i++) {
+          crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+        }
+
+        tables[0][b] = crc;
+      }
+
+      for (size_t k = 1; k < 8; k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+          tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xFF];
+        }
+      }
+
+      return tables;
+    }
+
+    inline constexpr auto Tables = MakeTables();
+
+    // Updates CRC register (without the initial and final inversion).
+    inline uint32_t UpdateTable(uint32_t crc, const uint8_t* data, size_t size) {
+      for (; size >= 8; data += 8, size -= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, data, sizeof(low));
+        memcpy(&high, data + 4, sizeof(high));
+
+        low ^= crc;
+
+        crc = Tables[7][low & 0xFF] ^ Tables[6][(low >> 8) & 0xFF] ^ Tables[5][(low >> 16) & 0xFF] ^ Tables[4][low >> 24] ^
+              Tables[3][high & 0xFF] ^ Tables[2][(high >> 8) & 0xFF] ^ Tables[1][(high >> 16) & 0xFF] ^ Tables[0][high >> 24];
+      }
+
+      for (; size > 0; data++, size--) {
+        crc = (crc >> 8) ^ Tables[0][(crc ^ *data) & 0xFF];
+      }
+
+      return crc;
+    }
+
+#ifdef SERIALIZATION_CONTRACT_CRC32C_X86
+    // x^n mod P, reflected.
+    constexpr uint32_t PowerOfX(size_t n) {
+      uint32_t power = 0x80000000;
+
+      for (size_t i = 0; i < n; i++) {
+        power = (power >> 1) ^ ((power & 1) ? Polynomial : 0);
+      }
+
+      return power;
+    }
+
+    // Parallel streams, each 'LongBlock' or 'ShortBlock' bytes.
+    constexpr size_t LongBlock = 8192;
+    constexpr size_t ShortBlock = 256;
+
+    // Shifting CRC by 'n' bytes is multiplication by x^(8n). Carry-less multiplication by x^(8n - 33),
+    // and 'crc32' of the 64 bit product (which multiplies by x^33) reduce it mod P.
+    constexpr uint32_t LongShift1 = PowerOfX(8 * LongBlock - 33);
+    constexpr uint32_t LongShift2 = PowerOfX(8 * 2 * LongBlock - 33);
+    constexpr uint32_t ShortShift1 = PowerOfX(8 * ShortBlock - 33);
+    constexpr uint32_t ShortShift2 = PowerOfX(8 * 2 * ShortBlock - 33);
+
+    __attribute__((target("sse4.2,pclmul")))
+    inline uint32_t Shift(uint32_t crc, uint32_t power) {
+      auto product = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int)crc), _mm_cvtsi32_si128((int)power), 0);
+
+      return (uint32_t)_mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(product));
+    }
+
+    // 3 streams hide the latency of 'crc32', and are combined by 'Shift'.
+    template <size_t Block>
+    __attribute__((target("sse4.2,pclmul")))
+    inline uint32_t UpdateStreams(uint32_t crc, const uint8_t*& data, size_t& size, uint32_t shift1, uint32_t shift2) {
+      for (; size >= 3 * Block; data += 3 * Block, size -= 3 * Block) {
+        uint64_t crc0 = crc;
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+
+        for (size_t i = 0; i < Block; i += 8) {
+          uint64_t word0;
+          uint64_t word1;
+          uint64_t word2;
+          memcpy(&word0, data + i, sizeof(word0));
+          memcpy(&word1, data + Block + i, sizeof(word1));
+          memcpy(&word2, data + 2 * Block + i, sizeof(word2));
+
+          crc0 = _mm_crc32_u64(crc0, word0);
+          crc1 = _mm_crc32_u64(crc1, word1);
+          crc2 = _mm_crc32_u64(crc2, word2);
+        }
+
+        crc = Shift((uint32_t)crc0, shift2) ^ Shift((uint32_t)crc1, shift1) ^ (uint32_t)crc2;
+      }
+
+      return crc;
+    }
+
+    __attribute__((target("sse4.2,pclmul")))
+    inline uint32_t UpdateHardware(uint32_t crc, const uint8_t* data, size_t size) {
+      crc = UpdateStreams<LongBlock>(crc, data, size, LongShift1, LongShift2);
+      crc = UpdateStreams<ShortBlock>(crc, data, size, ShortShift1, ShortShift2);
+
+      uint64_t crc64 = crc;
+
+      for (; size >= 8; data += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+
+        crc64 = _mm_crc32_u64(crc64, word);
+      }
+
+      crc = (uint32_t)crc64;
+
+      for (; size > 0; data++, size--) {
+        crc = _mm_crc32_u8(crc, *data);
+      }
+
+      return crc;
+    }
+
+    inline bool HasHardware() {
+      static const bool s_hasHardware = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+      return s_hasHardware;
+    }
+#endif
+  }
+
+  // CRC32C of 'data', 'crc' continues a previous CRC.
+  inline checksum_t ComputeChecksum(const uint8_t* data, size_t size, checksum_t crc = 0) {
+#ifdef SERIALIZATION_CONTRACT_CRC32C_X86
+    if (Crc32c::HasHardware()) {
+      return ~Crc32c::UpdateHardware(~crc, data, size);
+    }
+#endif
+
+    return ~Crc32c::UpdateTable(~crc, data, size);
+  }
+
+  // Returns size without the checksum, or 'false' when the checksum is missing or doesn't match.
+  inline bool VerifyChecksum(const uint8_t* data, size_t& size) {
+    if (size < sizeof(checksum_t)) {
+      return false;
+    }
+
+    size -= sizeof(checksum_t);
+
+    checksum_t checksum;
+    memcpy(&checksum, data + size, sizeof(checksum));
+
+    return checksum == ComputeChecksum(data, size);
+  }
+}
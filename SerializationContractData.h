@@ -3,6 +3,7 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <list>
 #include <forward_list>
 #include <deque>
@@ -22,17 +23,435 @@
 #include <optional>
 #include <variant>
 #include <functional>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
 
 namespace SerializationContract {
   using bytes_t = std::vector<uint8_t>;
 
+  //
+  // Parallel
+  //
+  // A 'std::vector' with at least 'threshold' elements is encoded in 'threads' chunks in parallel,
+  // with an index of the chunk sizes, so it can be decoded in parallel too. Disabled by default ('threads' is 1).
+  //
+  struct ParallelOptions {
+    unsigned threads = 1;
+    size_t threshold = 64 * 1024;
+  };
+
+  inline ParallelOptions& Parallel() {
+    static ParallelOptions s_options;
+    return s_options;
+  }
+
+  // The high bit of the size of a chunked 'std::vector'.
+  constexpr size_t ChunkedSizeFlag = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+  // The second high bit of the size of a columnar 'std::vector'.
+  constexpr size_t ColumnarSizeFlag = ChunkedSizeFlag >> 1;
+
+  // Nested vectors inside a chunk are not split again.
+  inline bool& InParallelWorker() {
+    thread_local bool s_inParallelWorker = false;
+    return s_inParallelWorker;
+  }
+
+  inline size_t ParallelChunkCount(size_t size) {
+    const auto& options = Parallel();
+
+    if (options.threads <= 1 || size < options.threshold || InParallelWorker()) {
+      return 1;
+    }
+
+    // Chunks are not empty.
+    return std::min<size_t>(options.threads, size);
+  }
+
+  // First element of chunk 'i' of 'count' chunks.
+  inline size_t ChunkBegin(size_t i, size_t size, size_t count) {
+    return (size / count) * i + std::min(i, size % count);
+  }
+
+  //
+  // ThreadPool
+  //
+  class ThreadPool {
+  public:
+    // 'threads' includes the thread calling 'Run'.
+    ThreadPool(unsigned threads) {
+      for (unsigned i = 1; i < threads; i++) {
+        workers_.emplace_back([this]() { Work(); });
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+      }
+
+      workCondition_.notify_all();
+
+      for (auto& worker : workers_) {
+        worker.join();
+      }
+    }
+
+    // Pool threads and the calling thread.
+    unsigned Threads() const {
+      return (unsigned)workers_.size() + 1;
+    }
+
+    // Calls 'f(i)' for 'i' in [0, count) on the pool threads and the calling thread, and waits for all calls.
+    template <typename F>
+    void Run(size_t count, F f) {
+      Batch batch(count, f);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batches_.push_back(&batch);
+      }
+
+      workCondition_.notify_all();
+
+      batch.Execute();
+
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      if (auto it = std::find(batches_.begin(), batches_.end(), &batch); it != batches_.end()) {
+        batches_.erase(it);
+      }
+
+      doneCondition_.wait(lock, [&]() { return batch.workers == 0; });
+
+      if (batch.exception) {
+        std::rethrow_exception(batch.exception);
+      }
+    }
+
+  private:
+    struct Batch {
+      Batch(size_t count, std::function<void(size_t)> f)
+        : count(count), f(std::move(f))
+      {}
+
+      void Execute() {
+        for (size_t i; (i = next++) < count;) {
+          try {
+            f(i);
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(exceptionMutex);
+            exception = std::current_exception();
+          }
+        }
+      }
+
+      size_t count;
+      std::function<void(size_t)> f;
+      std::atomic<size_t> next = 0;
+      size_t workers = 0; // Pool threads executing the batch, guarded by 'ThreadPool::mutex_'.
+      std::exception_ptr exception;
+      std::mutex exceptionMutex;
+    };
+
+    void Work() {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      for (;;) {
+        workCondition_.wait(lock, [&]() { return stopped_ || !batches_.empty(); });
+
+        if (stopped_) {
+          return;
+        }
+
+        // The batch stays queued while it has calls to claim, so other threads can join it.
+        auto batch = batches_.front();
+        batch->workers++;
+
+        lock.unlock();
+        batch->Execute();
+        lock.lock();
+
+        if (!batches_.empty() && batches_.front() == batch) {
+          batches_.pop_front();
+        }
+
+        batch->workers--;
+        doneCondition_.notify_all();
+      }
+    }
+
+    std::vector<std::thread> workers_;
+    std::deque<Batch*> batches_;
+    std::mutex mutex_;
+    std::condition_variable workCondition_;
+    std::condition_variable doneCondition_;
+    bool stopped_ = false;
+  };
+
+  // The pool of 'Parallel().threads' threads, it is replaced when 'threads' changes.
+  inline std::shared_ptr<ThreadPool> ParallelPool() {
+    static std::mutex s_mutex;
+    static std::shared_ptr<ThreadPool> s_pool;
+
+    auto threads = std::max(Parallel().threads, 1u);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    if (!s_pool || s_pool->Threads() != threads) {
+      s_pool = std::make_shared<ThreadPool>(threads);
+    }
+
+    return s_pool;
+  }
+
+  // Calls 'f(i)' for 'i' in [0, count) on 'ParallelPool', including the calling thread.
+  template <typename F>
+  void ParallelFor(size_t count, F f) {
+    ParallelPool()->Run(count, [&](size_t i) {
+      auto inParallelWorker = std::exchange(InParallelWorker(), true);
+
+      try {
+        f(i);
+      } catch (...) {
+        InParallelWorker() = inParallelWorker;
+        throw;
+      }
+
+      InParallelWorker() = inParallelWorker;
+    });
+  }
+
+  //
+  // Columnar
+  //
+  // A 'std::vector' of 'std::tuple' or 'std::pair' is encoded by columns: each field of all elements is written contiguously.
+  // Fixed size columns are written at fixed offsets, and string columns as an array of end offsets and one blob of characters.
+  // A vector which is also encoded in parallel chunks (see 'Parallel') is encoded by columns in each chunk.
+  // Disabled by default, columnar vectors are decoded regardless of 'enabled'.
+  //
+  struct ColumnarOptions {
+    bool enabled = false;
+  };
+
+  inline ColumnarOptions& Columnar() {
+    static ColumnarOptions s_options;
+    return s_options;
+  }
+
+  template <typename T>
+  struct IsTupleLike : std::false_type {};
+
+  template <typename ...Ts>
+  struct IsTupleLike<std::tuple<Ts...>> : std::true_type {};
+
+  template <typename T1, typename T2>
+  struct IsTupleLike<std::pair<T1, T2>> : std::true_type {};
+
+  template <typename T>
+  constexpr bool IsString = std::is_same_v<T, std::string> || std::is_same_v<T, std::wstring>;
+
+  //
+  // FixedSize
+  //
+  // Types with a compile time encoded size: built-in types, and 'std::array', 'std::tuple', 'std::pair' of them.
+  // They are written and read at fixed offsets, with the same encoding as 'operator <<' and 'operator >>'.
+  //
+  template <typename T, typename = void>
+  struct FixedSize : std::false_type {
+    static constexpr size_t Size = 0;
+  };
+
+  template <typename T>
+  struct FixedSize<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>> : std::true_type {
+    static constexpr size_t Size = sizeof(T);
+
+    static void Write(uint8_t* data, const T& t) {
+      memcpy(data, &t, sizeof(T));
+    }
+
+    static void Read(const uint8_t* data, T& t) {
+      memcpy(&t, data, sizeof(T));
+    }
+  };
+
+  template <typename T, size_t N>
+  struct FixedSize<std::array<T, N>> : std::bool_constant<FixedSize<T>::value> {
+    static constexpr size_t Size = N * FixedSize<T>::Size;
+
+    static void Write(uint8_t* data, const std::array<T, N>& t) {
+      for (size_t i = 0; i < N; i++) {
+        FixedSize<T>::Write(data + i * FixedSize<T>::Size, t[i]);
+      }
+    }
+
+    static void Read(const uint8_t* data, std::array<T, N>& t) {
+      for (size_t i = 0; i < N; i++) {
+        FixedSize<T>::Read(data + i * FixedSize<T>::Size, t[i]);
+      }
+    }
+  };
+
+  template <typename T1, typename T2>
+  struct FixedSize<std::pair<T1, T2>> : std::bool_constant<FixedSize<T1>::value && FixedSize<T2>::value> {
+    static constexpr size_t Size = FixedSize<T1>::Size + FixedSize<T2>::Size;
+
+    static void Write(uint8_t* data, const std::pair<T1, T2>& t) {
+      FixedSize<T1>::Write(data, t.first);
+      FixedSize<T2>::Write(data + FixedSize<T1>::Size, t.second);
+    }
+
+    static void Read(const uint8_t* data, std::pair<T1, T2>& t) {
+      FixedSize<T1>::Read(data, t.first);
+      FixedSize<T2>::Read(data + FixedSize<T1>::Size, t.second);
+    }
+  };
+
+  // 'Write' and 'Read' also accept a tuple of references to 'Ts...'.
+  template <typename ...Ts>
+  struct FixedSize<std::tuple<Ts...>> : std::bool_constant<(FixedSize<Ts>::value && ...)> {
+    static constexpr size_t Size = (FixedSize<Ts>::Size + ... + 0);
+
+    template <typename Tuple>
+    static void Write(uint8_t* data, const Tuple& t) {
+      Write(data, t, std::index_sequence_for<Ts...>{});
+    }
+
+    template <typename Tuple>
+    static void Read(const uint8_t* data, Tuple&& t) {
+      Read(data, t, std::index_sequence_for<Ts...>{});
+    }
+
+  private:
+    static constexpr std::array<size_t, sizeof...(Ts) + 1> Offsets() {
+      std::array<size_t, sizeof...(Ts) + 1> offsets = {};
+      constexpr size_t sizes[] = { FixedSize<Ts>::Size..., 0 };
+
+      for (size_t i = 0; i < sizeof...(Ts); i++) {
+        offsets[i + 1] = offsets[i] + sizes[i];
+      }
+
+      return offsets;
+    }
+
+    static constexpr auto offsets_ = Offsets();
+
+    template <typename Tuple, size_t ...I>
+    static void Write(uint8_t* data, const Tuple& t, std::index_sequence<I...>) {
+      (FixedSize<Ts>::Write(data + offsets_[I], std::get<I>(t)), ...);
+    }
+
+    template <typename Tuple, size_t ...I>
+    static void Read(const uint8_t* data, Tuple& t, std::index_sequence<I...>) {
+      (FixedSize<Ts>::Read(data + offsets_[I], std::get<I>(t)), ...);
+    }
+  };
+
+  // Lower bound of the encoded size of 'T', element counts which don't fit in the remaining bytes are rejected before allocation.
+  // It is 0 when unknown (i.e. for a custom struct), and then an element is counted as 1 byte.
+  template <typename T>
+  struct MinEncodedSize : std::integral_constant<size_t, FixedSize<T>::Size> {};
+
+  // Containers and variants start with a 'size_t' size or index.
+  template <typename T>
+  struct MinEncodedSize<std::basic_string<T>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename T>
+  struct MinEncodedSize<std::vector<T>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename T>
+  struct MinEncodedSize<std::list<T>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename T>
+  struct MinEncodedSize<std::deque<T>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename T>
+  struct MinEncodedSize<std::set<T>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename T>
+  struct MinEncodedSize<std::unordered_set<T>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename TKey, typename TValue>
+  struct MinEncodedSize<std::map<TKey, TValue>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename TKey, typename TValue>
+  struct MinEncodedSize<std::unordered_map<TKey, TValue>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  template <typename ...Ts>
+  struct MinEncodedSize<std::variant<Ts...>> : std::integral_constant<size_t, sizeof(size_t)> {};
+
+  // 'bool' of 'has_value'.
+  template <typename T>
+  struct MinEncodedSize<std::optional<T>> : std::integral_constant<size_t, sizeof(bool)> {};
+
+  template <typename T1, typename T2>
+  struct MinEncodedSize<std::pair<T1, T2>> : std::integral_constant<size_t, MinEncodedSize<T1>::value + MinEncodedSize<T2>::value> {};
+
+  template <typename ...Ts>
+  struct MinEncodedSize<std::tuple<Ts...>> : std::integral_constant<size_t, (MinEncodedSize<Ts>::value + ... + 0)> {};
+
+  // Thrown when the serialized bytes end before the encoded data, or the encoded sizes are inconsistent.
+  struct UnserializeError : std::out_of_range {
+    using std::out_of_range::out_of_range;
+  };
+
   struct Serializer {
-    Serializer(bytes_t& bytes) : bytes_(bytes) { bytes_.clear(); }
+    Serializer(bytes_t& bytes) : bytes_(&bytes) { bytes_->clear(); }
+
+    // Measures the encoded size, without writing.
+    Serializer() = default;
+
+    // Writes to [data, data + capacity), e.g. to a precomputed offset in a larger buffer.
+    Serializer(uint8_t* data, size_t capacity) : data_(data), capacity_(capacity) {}
 
     template <typename T>
     void Serialize(const T& t) {
       const uint8_t* dataPtr = reinterpret_cast<const uint8_t*>(&t);
-      bytes_.insert(bytes_.end(), dataPtr, dataPtr + sizeof(T));
+
+      if (bytes_) {
+        bytes_->insert(bytes_->end(), dataPtr, dataPtr + sizeof(T));
+      } else if (auto data = Extend(sizeof(T))) {
+        memcpy(data, dataPtr, sizeof(T));
+      }
+    }
+
+    // Appends 'size' bytes to be written by the caller, returns 'nullptr' when measuring.
+    uint8_t* Extend(size_t size) {
+      if (bytes_) {
+        auto offset = bytes_->size();
+        bytes_->resize(offset + size);
+
+        return bytes_->data() + offset;
+      }
+
+      auto offset = size_;
+      size_ += size;
+
+      if (data_ == nullptr) {
+        return nullptr;
+      }
+
+      if (size_ > capacity_ || size_ < offset) {
+        throw std::length_error("Serializer: data is larger than the buffer");
+      }
+
+      return data_ + offset;
+    }
+
+    // Encoded size.
+    size_t Size() const {
+      return bytes_ ? bytes_->size() : size_;
+    }
+
+    // Written bytes, 'nullptr' when measuring.
+    uint8_t* Data() const {
+      return bytes_ ? bytes_->data() : data_;
     }
 
     template <typename T>
@@ -68,6 +487,110 @@ namespace SerializationContract {
       return *this;
     }
 
+    // The chunk sizes are measured in parallel, and then the chunks are encoded in parallel at their offsets after the chunk index.
+    // With 'Columnar().enabled', each chunk of a vector of tuples is encoded by columns.
+    template <typename T>
+    Serializer& ParallelVector(const std::vector<T>& t, size_t chunkCount) {
+      bool columnar = false;
+
+      if constexpr (IsTupleLike<T>::value) {
+        columnar = Columnar().enabled;
+      }
+
+      Serialize(t.size() | ChunkedSizeFlag | (columnar ? ColumnarSizeFlag : 0));
+      Serialize(chunkCount);
+
+      auto chunk = [&](Serializer& serializer, size_t i) {
+        auto first = ChunkBegin(i, t.size(), chunkCount);
+        auto last = ChunkBegin(i + 1, t.size(), chunkCount);
+
+        if constexpr (IsTupleLike<T>::value) {
+          if (columnar) {
+            serializer.Columns(t, first, last, std::make_index_sequence<std::tuple_size_v<T>>{});
+            return;
+          }
+        }
+
+        for (auto j = first; j < last; j++) {
+          serializer << t[j];
+        }
+      };
+
+      std::vector<size_t> offsets(chunkCount + 1, 0);
+
+      ParallelFor(chunkCount, [&](size_t i) {
+        Serializer serializer;
+        chunk(serializer, i);
+
+        offsets[i + 1] = serializer.Size();
+      });
+
+      for (size_t i = 0; i < chunkCount; i++) {
+        Serialize(offsets[i + 1]);
+
+        offsets[i + 1] += offsets[i];
+      }
+
+      auto data = Extend(offsets[chunkCount]);
+
+      if (data) {
+        ParallelFor(chunkCount, [&](size_t i) {
+          Serializer serializer(data + offsets[i], offsets[i + 1] - offsets[i]);
+          chunk(serializer, i);
+        });
+      }
+
+      return *this;
+    }
+
+    template <typename T>
+    Serializer& ColumnarVector(const std::vector<T>& t) {
+      Serialize(t.size() | ColumnarSizeFlag);
+
+      Columns(t, 0, t.size(), std::make_index_sequence<std::tuple_size_v<T>>{});
+
+      return *this;
+    }
+
+    // Columns of elements [first, last).
+    template <typename T, size_t ...I>
+    void Columns(const std::vector<T>& t, size_t first, size_t last, std::index_sequence<I...>) {
+      (Column<I>(t, first, last), ...);
+    }
+
+    template <size_t I, typename T>
+    void Column(const std::vector<T>& t, size_t first, size_t last) {
+      using C = std::tuple_element_t<I, T>;
+
+      if constexpr (FixedSize<C>::value) {
+        auto data = Extend((last - first) * FixedSize<C>::Size);
+
+        for (size_t i = first; data && i < last; i++) {
+          FixedSize<C>::Write(data + (i - first) * FixedSize<C>::Size, std::get<I>(t[i]));
+        }
+      } else if constexpr (IsString<C>) {
+        size_t end = 0;
+
+        for (size_t i = first; i < last; i++) {
+          end += std::get<I>(t[i]).size();
+          Serialize(end);
+        }
+
+        auto data = Extend(end * sizeof(typename C::value_type));
+
+        for (size_t i = first; data && i < last; i++) {
+          const auto& str = std::get<I>(t[i]);
+
+          memcpy(data, str.data(), str.size() * sizeof(typename C::value_type));
+          data += str.size() * sizeof(typename C::value_type);
+        }
+      } else {
+        for (size_t i = first; i < last; i++) {
+          *this << std::get<I>(t[i]);
+        }
+      }
+    }
+
     template<typename T>
     Serializer& ContainerAdapter(const T& t) {
       auto tmp = t;
@@ -82,22 +605,35 @@ namespace SerializationContract {
       return *this;
     }
 
+    // Serialized bytes of a serializer constructed with 'bytes'.
     const bytes_t& Bytes() const {
-      return bytes_;
+      return *bytes_;
     }
 
   private:
-    bytes_t& bytes_;
+    bytes_t* bytes_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
   };
 
   struct Unserializer {
-    Unserializer(const bytes_t& bytes) : bytes_(bytes) {}
+    Unserializer(const bytes_t& bytes) : data_(bytes.data()), size_(bytes.size()) {}
+
+    // Unserializes in place, e.g. from a slot in shared memory.
+    Unserializer(const uint8_t* data, size_t size) : data_(data), size_(size) {}
 
     template <typename T>
     void Unserialize(T& t) {
-      memcpy((void*)&t, &bytes_[index_], sizeof(T));
+      memcpy((void*)&t, Take(sizeof(T)), sizeof(T));
+    }
+
+    // Reads without moving the position.
+    template <typename T>
+    void Peek(T& t) const {
+      Require(sizeof(T));
 
-      index_ += sizeof(T);
+      memcpy((void*)&t, Data(), sizeof(T));
     }
 
     template <typename T>
@@ -156,6 +692,157 @@ namespace SerializationContract {
       return *this;
     }
 
+    template <typename T>
+    Unserializer& Vector(std::vector<T>& t) {
+      if constexpr (!std::is_same_v<T, bool>) {
+        size_t size;
+        Peek(size);
+
+        if (size & ChunkedSizeFlag) {
+          return ParallelVector(t);
+        }
+
+        if constexpr (IsTupleLike<T>::value) {
+          if (size & ColumnarSizeFlag) {
+            return ColumnarVector(t);
+          }
+        }
+      }
+
+      return SequenceContainer(t);
+    }
+
+    // Chunks are decoded in parallel into their elements, using the chunk index.
+    template <typename T>
+    Unserializer& ParallelVector(std::vector<T>& t) {
+      size_t size;
+      Unserialize(size);
+
+      bool columnar = size & ColumnarSizeFlag;
+      size &= ~(ChunkedSizeFlag | ColumnarSizeFlag);
+
+      if (columnar && !IsTupleLike<T>::value) {
+        throw UnserializeError("Unserializer: columnar chunks of a vector which is not of tuples");
+      }
+
+      size_t chunkCount;
+      Unserialize(chunkCount);
+
+      if (chunkCount == 0 || chunkCount > Remaining() / sizeof(size_t)) {
+        throw UnserializeError("Unserializer: invalid chunk count");
+      }
+
+      std::vector<size_t> offsets(chunkCount + 1, 0);
+
+      for (size_t i = 0; i < chunkCount; i++) {
+        size_t chunkSize;
+        Unserialize(chunkSize);
+
+        offsets[i + 1] = offsets[i] + chunkSize;
+
+        if (offsets[i + 1] < offsets[i]) {
+          throw UnserializeError("Unserializer: invalid chunk size");
+        }
+      }
+
+      auto data = Take(offsets[chunkCount]);
+
+      RequireCount<T>(size, offsets[chunkCount]);
+
+      t.clear();
+      t.resize(size);
+
+      ParallelFor(chunkCount, [&](size_t i) {
+        Unserializer unserializer(data + offsets[i], offsets[i + 1] - offsets[i]);
+
+        auto first = ChunkBegin(i, size, chunkCount);
+        auto last = ChunkBegin(i + 1, size, chunkCount);
+
+        if constexpr (IsTupleLike<T>::value) {
+          if (columnar) {
+            unserializer.Columns(t, first, last, std::make_index_sequence<std::tuple_size_v<T>>{});
+            return;
+          }
+        }
+
+        for (auto j = first; j < last; j++) {
+          unserializer >> t[j];
+        }
+      });
+
+      return *this;
+    }
+
+    template <typename T>
+    Unserializer& ColumnarVector(std::vector<T>& t) {
+      size_t size;
+      Unserialize(size);
+      size &= ~ColumnarSizeFlag;
+
+      RequireCount<T>(size, Remaining());
+
+      t.clear();
+      t.resize(size);
+
+      Columns(t, 0, size, std::make_index_sequence<std::tuple_size_v<T>>{});
+
+      return *this;
+    }
+
+    // Columns of elements [first, last), 't' is already resized.
+    template <typename T, size_t ...I>
+    void Columns(std::vector<T>& t, size_t first, size_t last, std::index_sequence<I...>) {
+      (Column<I>(t, first, last), ...);
+    }
+
+    template <size_t I, typename T>
+    void Column(std::vector<T>& t, size_t first, size_t last) {
+      using C = std::tuple_element_t<I, T>;
+
+      if constexpr (FixedSize<C>::value) {
+        auto data = Take((last - first) * FixedSize<C>::Size);
+
+        for (size_t i = first; i < last; i++) {
+          FixedSize<C>::Read(data + (i - first) * FixedSize<C>::Size, std::get<I>(t[i]));
+        }
+      } else if constexpr (IsString<C>) {
+        using CharT = typename C::value_type;
+
+        auto ends = Take((last - first) * sizeof(size_t));
+
+        size_t charCount = 0;
+
+        if (last > first) {
+          memcpy(&charCount, ends + (last - first - 1) * sizeof(size_t), sizeof(charCount));
+        }
+
+        RequireCount<CharT>(charCount, Remaining());
+
+        auto chars = Take(charCount * sizeof(CharT));
+
+        size_t begin = 0;
+
+        for (size_t i = first; i < last; i++) {
+          size_t end;
+          memcpy(&end, ends + (i - first) * sizeof(size_t), sizeof(end));
+
+          if (end < begin || end > charCount) {
+            throw UnserializeError("Unserializer: invalid string column");
+          }
+
+          auto& str = std::get<I>(t[i]);
+          str.resize(end - begin);
+          memcpy(str.data(), chars + begin * sizeof(CharT), str.size() * sizeof(CharT));
+
+          begin = end;
+        }
+      } else {
+        for (size_t i = first; i < last; i++) {
+          *this >> std::get<I>(t[i]);
+        }
+      }
+    }
+
     template<typename T>
     Unserializer& ContainerAdapter(T& t) {
       t = {};
@@ -174,9 +861,43 @@ namespace SerializationContract {
       return *this;
     }
 
+    // Current position.
+    const uint8_t* Data() const {
+      return data_ + index_;
+    }
+
+    size_t Remaining() const {
+      return size_ - index_;
+    }
+
+    // Returns the current position, and moves it by 'size' bytes.
+    const uint8_t* Take(size_t size) {
+      Require(size);
+
+      auto data = Data();
+      index_ += size;
+
+      return data;
+    }
+
   private:
-    const bytes_t& bytes_;
-    int index_ = 0;
+    void Require(size_t size) const {
+      if (size > Remaining()) {
+        throw UnserializeError("Unserializer: unexpected end of data");
+      }
+    }
+
+    // 'count' elements of 'T' must fit in 'size' bytes.
+    template <typename T>
+    static void RequireCount(size_t count, size_t size) {
+      if (count > size / std::max<size_t>(MinEncodedSize<T>::value, 1)) {
+        throw UnserializeError("Unserializer: invalid element count");
+      }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t index_ = 0;
   };
 
   // Built-in types
@@ -223,12 +944,24 @@ namespace SerializationContract {
   // vector
   template<typename T>
   Serializer& operator << (Serializer& serializer, const std::vector<T>& t) {
+    if constexpr (!std::is_same_v<T, bool>) {
+      if (auto chunkCount = ParallelChunkCount(t.size()); chunkCount > 1) {
+        return serializer.ParallelVector(t, chunkCount);
+      }
+    }
+
+    if constexpr (IsTupleLike<T>::value) {
+      if (Columnar().enabled) {
+        return serializer.ColumnarVector(t);
+      }
+    }
+
     return serializer.SequenceContainer(t);
   }
 
   template<typename T>
   Unserializer& operator >> (Unserializer& unserializer, std::vector<T>& t) {
-    return unserializer.SequenceContainer(t);
+    return unserializer.Vector(t);
   }
 
   // list
@@ -265,7 +998,7 @@ namespace SerializationContract {
   }
 
   // array
-  template<typename T, int N>
+  template<typename T, size_t N>
   Serializer& operator << (Serializer& serializer, const std::array<T, N>& t) {
     for (const auto& el : t) {
       serializer << el;
@@ -274,7 +1007,7 @@ namespace SerializationContract {
     return serializer;
   }
 
-  template<typename T, int N>
+  template<typename T, size_t N>
   Unserializer& operator >> (Unserializer& unserializer, std::array<T, N>& t) {
     for (size_t i = 0; i < t.size(); i++) {
       T el;
@@ -418,37 +1151,16 @@ namespace SerializationContract {
   }
 
   // tuple
-  template<int n>
-  struct Tuple {
-    template <typename ...Ts>
-    static void Serialize(Serializer& serializer, const std::tuple<Ts...>& t) {
-      if constexpr (n > 1) {
-        Tuple<n - 1>::Serialize(serializer, t);
-      }
-
-      serializer << std::get<n - 1>(t);
-    }
-
-    template <typename ...Ts>
-    static void Unserialize(Unserializer& unserializer, std::tuple<Ts...>& t) {
-      if constexpr (n > 1) {
-        Tuple<n - 1>::Unserialize(unserializer, t);
-      }
-
-      unserializer >> std::get<n - 1>(t);
-    }
-  };
-
   template<typename ...Ts>
   Serializer& operator << (Serializer& serializer, const std::tuple<Ts...>& t) {
-    Tuple<sizeof...(Ts)>::Serialize(serializer, t);
+    std::apply([&](const auto&... el) { (serializer << ... << el); }, t);
 
     return serializer;
   }
 
   template<typename ...Ts>
   Unserializer& operator >> (Unserializer& unserializer, std::tuple<Ts...>& t) {
-    Tuple<sizeof...(Ts)>::Unserialize(unserializer, t);
+    std::apply([&](auto&... el) { (unserializer >> ... >> el); }, t);
 
     return unserializer;
   }
@@ -509,20 +1221,26 @@ namespace SerializationContract {
     return serializer;
   }
 
-  template <size_t I = 0, typename... Ts>
-  void UnserializeVariant(Unserializer& unserializer, std::variant<Ts...>& t, size_t index) {
-    if constexpr (I < sizeof...(Ts)) {
-      if (I == index) {
-        std::variant_alternative_t<I, std::variant<Ts...>> val;
-        unserializer >> val;
+  template <size_t I, typename... Ts>
+  void UnserializeVariantAlternative(Unserializer& unserializer, std::variant<Ts...>& t) {
+    std::variant_alternative_t<I, std::variant<Ts...>> val;
+    unserializer >> val;
 
-        t.template emplace<I>(std::move(val));
+    t.template emplace<I>(std::move(val));
+  }
 
-        return;
-      }
+  // The alternative is selected by a table of functions, indexed by the encoded index.
+  template <typename... Ts, size_t... I>
+  void UnserializeVariant(Unserializer& unserializer, std::variant<Ts...>& t, size_t index, std::index_sequence<I...>) {
+    using UnserializeAlternative = void (*)(Unserializer&, std::variant<Ts...>&);
 
-      UnserializeVariant<I + 1>(unserializer, t, index);
+    static constexpr UnserializeAlternative s_alternatives[] = { &UnserializeVariantAlternative<I, Ts...>... };
+
+    if (index >= sizeof...(Ts)) {
+      throw UnserializeError("Unserializer: invalid variant index");
     }
+
+    s_alternatives[index](unserializer, t);
   }
 
   template<typename... Ts>
@@ -530,7 +1248,7 @@ namespace SerializationContract {
     size_t index;
     unserializer >> index;
 
-    UnserializeVariant(unserializer, t, index);
+    UnserializeVariant(unserializer, t, index, std::index_sequence_for<Ts...>{});
 
     return unserializer;
   }
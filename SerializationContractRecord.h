@@ -0,0 +1,689 @@
+// Recording of 'SERIALIZATION_CONTRACT' messages to a capture file, and their replay to 'ON_SERIALIZATION_CONTRACT' (POSIX).
+
+#pragma once
+
+#include "SerializationContract.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string_view>
+#include <unordered_map>
+#include <deque>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace SerializationContract {
+  //
+  // Capture file: 'CaptureFileHeader', then for each message 'CaptureRecordHeader' and the message bytes.
+  // Index file (capture file path + ".index"): 'CaptureFileHeader', then 'CaptureIndexEntry' for each message.
+  // Postings file (capture file path + ".postings"): 'CaptureFileHeader', then for each flush of the recorder
+  // 'CapturePostingsHeader' and, for each contract name in the flush, 'CapturePostingsBlock' and the sorted message positions.
+  //
+  constexpr uint64_t CaptureFileMagic = 0x5043435341524553; // "SERASCCP"
+  constexpr uint64_t CaptureIndexMagic = 0x5849435341524553; // "SERASCIX"
+  constexpr uint64_t CapturePostingsMagic = 0x5350435341524553; // "SERASCPS"
+  constexpr uint64_t CaptureVersion = 1;
+
+  struct CaptureFileHeader {
+    uint64_t magic;
+    uint64_t version;
+  };
+
+  struct CaptureRecordHeader {
+    uint64_t timestamp; // Nanoseconds since epoch.
+    uint64_t size;
+  };
+
+  struct CaptureIndexEntry {
+    uint64_t timestamp;
+    uint64_t offset; // Offset of 'CaptureRecordHeader' in the capture file.
+    uint64_t nameHash;
+  };
+
+  struct CapturePostingsHeader {
+    uint64_t first; // Messages [first, first + count) are in the blocks of this flush.
+    uint64_t count;
+    uint64_t size;  // Size of the blocks.
+  };
+
+  struct CapturePostingsBlock {
+    uint64_t nameHash;
+    uint64_t count; // Number of positions ('uint64_t') which follow.
+  };
+
+  // Name of the contract in serialized 'bytes', empty if 'bytes' are too short.
+  inline std::string_view ContractName(const uint8_t* data, size_t size) {
+    size_t nameSize;
+
+    if (size < sizeof(nameSize)) {
+      return {};
+    }
+
+    memcpy(&nameSize, data, sizeof(nameSize));
+
+    if (nameSize > size - sizeof(nameSize)) {
+      return {};
+    }
+
+    return std::string_view(reinterpret_cast<const char*>(data + sizeof(nameSize)), nameSize);
+  }
+
+  // FNV-1a
+  inline uint64_t ContractNameHash(std::string_view name) {
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (auto c : name) {
+      hash = (hash ^ (uint8_t)c) * 0x100000001B3;
+    }
+
+    return hash;
+  }
+
+  inline uint64_t CaptureTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  //
+  // ContractRecorder
+  //
+  // Appends messages to the capture and index files. Writes are buffered until 'Flush', or until 'BufferSize' is reached.
+  // Files of a recorder which crashed during a flush are repaired when they are opened again.
+  //
+  class ContractRecorder {
+  public:
+    static constexpr size_t BufferSize = 1024 * 1024;
+
+    ContractRecorder(const std::string& path) {
+      fd_ = Open(path, CaptureFileMagic);
+
+      try {
+        indexFd_ = Open(path + ".index", CaptureIndexMagic);
+        postingsFd_ = Open(path + ".postings", CapturePostingsMagic);
+      } catch (...) {
+        close(fd_);
+
+        if (indexFd_ >= 0) {
+          close(indexFd_);
+        }
+
+        throw;
+      }
+
+      try {
+        Recover();
+      } catch (...) {
+        close(fd_);
+        close(indexFd_);
+        close(postingsFd_);
+        throw;
+      }
+    }
+
+    ContractRecorder(const ContractRecorder&) = delete;
+    ContractRecorder& operator = (const ContractRecorder&) = delete;
+
+    // Buffered messages are flushed, errors are ignored (call 'Flush' to handle them).
+    ~ContractRecorder() {
+      try {
+        Flush();
+      } catch (...) {
+      }
+
+      close(fd_);
+      close(indexFd_);
+      close(postingsFd_);
+    }
+
+    // Can be called from multiple threads. Timestamps in the file don't decrease, so the index is sorted by time.
+    void Record(const uint8_t* data, size_t size, uint64_t timestamp = CaptureTimestamp()) {
+      auto nameHash = ContractNameHash(ContractName(data, size));
+
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      timestamp_ = std::max(timestamp_, timestamp);
+
+      CaptureRecordHeader header = { timestamp_, size };
+      CaptureIndexEntry entry = { timestamp_, offset_ + buffer_.size(), nameHash };
+
+      Append(buffer_, &header, sizeof(header));
+      Append(buffer_, data, size);
+      Append(indexBuffer_, &entry, sizeof(entry));
+
+      postings_[nameHash].push_back(position_++);
+
+      if (buffer_.size() >= BufferSize) {
+        FlushLocked();
+      }
+    }
+
+    void Record(const bytes_t& bytes) {
+      Record(bytes.data(), bytes.size());
+    }
+
+    void Flush() {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      FlushLocked();
+    }
+
+  private:
+    static int Open(const std::string& path, uint64_t magic) {
+      int fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "ContractRecorder open " + path);
+      }
+
+      try {
+        // A partially written header is written again.
+        if (FileSize(fd) < sizeof(CaptureFileHeader)) {
+          Truncate(fd, 0);
+
+          CaptureFileHeader header = { magic, CaptureVersion };
+          Write(fd, &header, sizeof(header));
+        }
+      } catch (...) {
+        close(fd);
+        throw;
+      }
+
+      return fd;
+    }
+
+    // Truncates the index to whole entries of complete records, adds complete records which are missing from the index,
+    // and truncates the capture file after the last complete record, and the postings file after the last complete flush.
+    void Recover() {
+      auto captureSize = FileSize(fd_);
+
+      position_ = (FileSize(indexFd_) - sizeof(CaptureFileHeader)) / sizeof(CaptureIndexEntry);
+      offset_ = sizeof(CaptureFileHeader);
+
+      for (; position_ > 0; position_--) {
+        CaptureIndexEntry entry;
+        Read(indexFd_, &entry, sizeof(entry), sizeof(CaptureFileHeader) + (position_ - 1) * sizeof(entry));
+
+        CaptureRecordHeader header;
+        if (IsComplete(captureSize, entry.offset, header)) {
+          offset_ = entry.offset + sizeof(header) + header.size;
+          timestamp_ = entry.timestamp;
+          break;
+        }
+      }
+
+      Truncate(indexFd_, sizeof(CaptureFileHeader) + position_ * sizeof(CaptureIndexEntry));
+
+      bytes_t data;
+
+      for (CaptureRecordHeader header; IsComplete(captureSize, offset_, header);) {
+        data.resize(header.size);
+        Read(fd_, data.data(), data.size(), offset_ + sizeof(header));
+
+        timestamp_ = std::max(timestamp_, header.timestamp);
+
+        CaptureIndexEntry entry = { timestamp_, offset_, ContractNameHash(ContractName(data.data(), data.size())) };
+        Write(indexFd_, &entry, sizeof(entry));
+
+        offset_ += sizeof(header) + header.size;
+        position_++;
+      }
+
+      Truncate(fd_, offset_);
+
+      auto postingsSize = FileSize(postingsFd_);
+      uint64_t postingsOffset = sizeof(CaptureFileHeader);
+
+      for (CapturePostingsHeader header; postingsSize - postingsOffset >= sizeof(header);) {
+        Read(postingsFd_, &header, sizeof(header), postingsOffset);
+
+        if (header.size > postingsSize - postingsOffset - sizeof(header)) {
+          break;
+        }
+
+        postingsOffset += sizeof(header) + header.size;
+      }
+
+      Truncate(postingsFd_, postingsOffset);
+
+      flushedPosition_ = position_;
+    }
+
+    // Reads the header of the record at 'offset', returns 'true' if the record is completely in the capture file.
+    bool IsComplete(uint64_t captureSize, uint64_t offset, CaptureRecordHeader& header) const {
+      if (offset > captureSize || captureSize - offset < sizeof(header)) {
+        return false;
+      }
+
+      Read(fd_, &header, sizeof(header), offset);
+
+      return header.size <= captureSize - offset - sizeof(header);
+    }
+
+    static uint64_t FileSize(int fd) {
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "ContractRecorder stat");
+      }
+
+      return st.st_size;
+    }
+
+    static void Truncate(int fd, uint64_t size) {
+      if (ftruncate(fd, size) != 0) {
+        throw std::system_error(errno, std::generic_category(), "ContractRecorder truncate");
+      }
+    }
+
+    static void Read(int fd, void* data, size_t size, uint64_t offset) {
+      auto dataPtr = static_cast<uint8_t*>(data);
+
+      while (size > 0) {
+        auto res = pread(fd, dataPtr, size, offset);
+        if (res <= 0) {
+          if (res < 0 && errno == EINTR) {
+            continue;
+          }
+
+          throw std::system_error(res < 0 ? errno : EIO, std::generic_category(), "ContractRecorder read");
+        }
+
+        dataPtr += res;
+        size -= res;
+        offset += res;
+      }
+    }
+
+    static void Append(bytes_t& buffer, const void* data, size_t size) {
+      auto dataPtr = static_cast<const uint8_t*>(data);
+      buffer.insert(buffer.end(), dataPtr, dataPtr + size);
+    }
+
+    static void Write(int fd, const void* data, size_t size) {
+      auto dataPtr = static_cast<const uint8_t*>(data);
+
+      while (size > 0) {
+        auto res = write(fd, dataPtr, size);
+        if (res < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+
+          throw std::system_error(errno, std::generic_category(), "ContractRecorder write");
+        }
+
+        dataPtr += res;
+        size -= res;
+      }
+    }
+
+    // The capture file is written before the index, and the index before the postings,
+    // so the index and the postings never refer to missing messages.
+    void FlushLocked() {
+      if (buffer_.empty()) {
+        return;
+      }
+
+      bytes_t postingsBuffer(sizeof(CapturePostingsHeader));
+
+      for (auto& [nameHash, positions] : postings_) {
+        CapturePostingsBlock block = { nameHash, positions.size() };
+        Append(postingsBuffer, &block, sizeof(block));
+        Append(postingsBuffer, positions.data(), positions.size() * sizeof(uint64_t));
+      }
+
+      CapturePostingsHeader postingsHeader = { flushedPosition_, position_ - flushedPosition_, postingsBuffer.size() - sizeof(CapturePostingsHeader) };
+      memcpy(postingsBuffer.data(), &postingsHeader, sizeof(postingsHeader));
+
+      Write(fd_, buffer_.data(), buffer_.size());
+      Write(indexFd_, indexBuffer_.data(), indexBuffer_.size());
+      Write(postingsFd_, postingsBuffer.data(), postingsBuffer.size());
+
+      offset_ += buffer_.size();
+      flushedPosition_ = position_;
+
+      buffer_.clear();
+      indexBuffer_.clear();
+      postings_.clear();
+    }
+
+    int fd_ = -1;
+    int indexFd_ = -1;
+    int postingsFd_ = -1;
+    uint64_t offset_ = 0;
+    uint64_t timestamp_ = 0;
+    uint64_t position_ = 0;        // Position of the next message.
+    uint64_t flushedPosition_ = 0; // Position of the first buffered message.
+    bytes_t buffer_;
+    bytes_t indexBuffer_;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> postings_; // Positions of the buffered messages by name hash.
+    std::mutex mutex_;
+  };
+
+  //
+  // ContractReplay
+  //
+  // Memory-maps the capture, index, and postings files for random access to the messages by position, time, or contract name.
+  // If the index file is missing, the index is built by scanning the capture file.
+  // Messages which are missing from the postings file are added to the postings by scanning their index entries.
+  //
+  class ContractReplay {
+  public:
+    struct Message {
+      uint64_t timestamp;
+      const uint8_t* data;
+      size_t size;
+    };
+
+    enum class Speed {
+      AsFastAsPossible,
+      Original
+    };
+
+    ContractReplay(const std::string& path) {
+      capture_ = Map(path, CaptureFileMagic, captureSize_);
+      if (capture_ == nullptr) {
+        throw std::system_error(ENOENT, std::generic_category(), "ContractReplay open " + path);
+      }
+
+      try {
+        index_ = Map(path + ".index", CaptureIndexMagic, indexSize_);
+        postingsFile_ = Map(path + ".postings", CapturePostingsMagic, postingsSize_);
+      } catch (...) {
+        munmap(const_cast<uint8_t*>(capture_), captureSize_);
+
+        if (index_) {
+          munmap(const_cast<uint8_t*>(index_), indexSize_);
+        }
+
+        throw;
+      }
+
+      if (index_) {
+        entries_ = reinterpret_cast<const CaptureIndexEntry*>(index_ + sizeof(CaptureFileHeader));
+        count_ = (indexSize_ - sizeof(CaptureFileHeader)) / sizeof(CaptureIndexEntry);
+
+        // The index may refer to messages written after the capture file was mapped.
+        while (count_ > 0 && !IsMapped(entries_[count_ - 1].offset)) {
+          count_--;
+        }
+      } else {
+        BuildIndex();
+      }
+
+      LoadPostings();
+    }
+
+    ContractReplay(const ContractReplay&) = delete;
+    ContractReplay& operator = (const ContractReplay&) = delete;
+
+    ~ContractReplay() {
+      munmap(const_cast<uint8_t*>(capture_), captureSize_);
+
+      if (index_) {
+        munmap(const_cast<uint8_t*>(index_), indexSize_);
+      }
+
+      if (postingsFile_) {
+        munmap(const_cast<uint8_t*>(postingsFile_), postingsSize_);
+      }
+    }
+
+    size_t Count() const {
+      return count_;
+    }
+
+    // Throws 'std::out_of_range' if the index entry of the message refers outside of the capture file.
+    Message At(size_t i) const {
+      Message message;
+
+      if (!TryAt(i, message)) {
+        throw std::out_of_range("ContractReplay: invalid message position");
+      }
+
+      return message;
+    }
+
+    // Position of the first message at or after 'timestamp'.
+    size_t LowerBound(uint64_t timestamp) const {
+      return std::lower_bound(entries_, entries_ + count_, timestamp,
+        [](const CaptureIndexEntry& entry, uint64_t timestamp) { return entry.timestamp < timestamp; }) - entries_;
+    }
+
+    // Positions of the messages of contract 'name' in [begin, end).
+    // The postings blocks of the name and the positions in them are binary searched, only messages of the name are visited.
+    std::vector<size_t> Find(std::string_view name, size_t begin = 0, size_t end = SIZE_MAX) const {
+      std::vector<size_t> positions;
+
+      end = std::min(end, count_);
+
+      auto it = postings_.find(ContractNameHash(name));
+      if (it == postings_.end()) {
+        return positions;
+      }
+
+      const auto& blocks = it->second;
+
+      auto block = std::lower_bound(blocks.begin(), blocks.end(), begin,
+        [](const PostingsBlock& block, size_t begin) { return block.positions[block.count - 1] < begin; });
+
+      for (; block != blocks.end() && block->positions[0] < end; ++block) {
+        auto blockEnd = block->positions + block->count;
+
+        for (auto position = std::lower_bound(block->positions, blockEnd, begin); position != blockEnd && *position < end; ++position) {
+          Message message;
+
+          // Different names can have the same hash.
+          if (TryAt(*position, message) && ContractName(message.data, message.size) == name) {
+            positions.push_back(*position);
+          }
+        }
+      }
+
+      return positions;
+    }
+
+    // Dispatches messages [begin, end) to 'ON_SERIALIZATION_CONTRACT', returns number of messages delivered to a subscriber.
+    // Messages whose index entries refer outside of the capture file are skipped.
+    // With multiple threads, thread 'k' dispatches messages k, k + threads, ..., so the handlers should be thread safe.
+    size_t Replay(Speed speed = Speed::AsFastAsPossible, unsigned threads = 1, size_t begin = 0, size_t end = SIZE_MAX) {
+      end = std::min(end, count_);
+      if (begin >= end) {
+        return 0;
+      }
+
+      std::atomic<size_t> dispatched = 0;
+
+      auto firstTimestamp = entries_[begin].timestamp;
+      auto start = std::chrono::steady_clock::now();
+
+      auto worker = [&](size_t first) {
+        for (size_t i = first; i < end; i += threads) {
+          Message message;
+
+          if (!TryAt(i, message)) {
+            continue;
+          }
+
+          if (speed == Speed::Original) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(message.timestamp - firstTimestamp));
+          }
+
+          if (UnserializeDispatcher::Instance().Dispatch(message.data, message.size)) {
+            dispatched.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      };
+
+      threads = std::max(threads, 1u);
+
+      std::vector<std::thread> workers;
+      for (unsigned k = 1; k < threads; k++) {
+        workers.emplace_back(worker, begin + k);
+      }
+
+      worker(begin);
+
+      for (auto& thread : workers) {
+        thread.join();
+      }
+
+      return dispatched;
+    }
+
+  private:
+    // Returns 'nullptr' if the file doesn't exist.
+    static const uint8_t* Map(const std::string& path, uint64_t magic, size_t& size) {
+      int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return nullptr;
+      }
+
+      struct stat st;
+      if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CaptureFileHeader)) {
+        close(fd);
+        throw std::system_error(EINVAL, std::generic_category(), "ContractReplay invalid file " + path);
+      }
+
+      size = st.st_size;
+
+      auto mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+
+      if (mapping == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "ContractReplay mmap " + path);
+      }
+
+      CaptureFileHeader header;
+      memcpy(&header, mapping, sizeof(header));
+
+      if (header.magic != magic || header.version != CaptureVersion) {
+        munmap(mapping, size);
+        throw std::system_error(EINVAL, std::generic_category(), "ContractReplay invalid file " + path);
+      }
+
+      return static_cast<const uint8_t*>(mapping);
+    }
+
+    // The index file may be corrupted, so each entry is checked before its message is read.
+    bool TryAt(size_t i, Message& message) const {
+      if (i >= count_ || !IsMapped(entries_[i].offset)) {
+        return false;
+      }
+
+      CaptureRecordHeader header;
+      memcpy(&header, capture_ + entries_[i].offset, sizeof(header));
+
+      message = { header.timestamp, capture_ + entries_[i].offset + sizeof(header), header.size };
+
+      return true;
+    }
+
+    bool IsMapped(uint64_t offset) const {
+      if (offset > captureSize_ || captureSize_ - offset < sizeof(CaptureRecordHeader)) {
+        return false;
+      }
+
+      CaptureRecordHeader header;
+      memcpy(&header, capture_ + offset, sizeof(header));
+
+      return header.size <= captureSize_ - offset - sizeof(header);
+    }
+
+    // A partially written last message is ignored.
+    void BuildIndex() {
+      for (size_t offset = sizeof(CaptureFileHeader); IsMapped(offset);) {
+        CaptureRecordHeader header;
+        memcpy(&header, capture_ + offset, sizeof(header));
+
+        auto name = ContractName(capture_ + offset + sizeof(header), header.size);
+        builtEntries_.push_back({ header.timestamp, offset, ContractNameHash(name) });
+
+        offset += sizeof(header) + header.size;
+      }
+
+      entries_ = builtEntries_.data();
+      count_ = builtEntries_.size();
+    }
+
+    // Blocks of complete flushes are used in place. A partially written flush, and messages which are not in the postings file,
+    // are added from the index.
+    void LoadPostings() {
+      uint64_t next = 0; // Position after the messages in the loaded blocks.
+
+      for (size_t offset = sizeof(CaptureFileHeader); postingsFile_ && postingsSize_ - offset >= sizeof(CapturePostingsHeader);) {
+        CapturePostingsHeader header;
+        memcpy(&header, postingsFile_ + offset, sizeof(header));
+
+        offset += sizeof(header);
+
+        if (header.size > postingsSize_ - offset || header.first < next) {
+          break;
+        }
+
+        ScanPostings(next, header.first);
+
+        auto end = offset + header.size;
+
+        while (end - offset >= sizeof(CapturePostingsBlock)) {
+          CapturePostingsBlock block;
+          memcpy(&block, postingsFile_ + offset, sizeof(block));
+
+          offset += sizeof(block);
+
+          if (block.count > (end - offset) / sizeof(uint64_t)) {
+            break;
+          }
+
+          if (block.count > 0) {
+            postings_[block.nameHash].push_back({ reinterpret_cast<const uint64_t*>(postingsFile_ + offset), block.count });
+          }
+
+          offset += block.count * sizeof(uint64_t);
+        }
+
+        offset = end;
+        next = header.first + header.count;
+      }
+
+      ScanPostings(next, count_);
+    }
+
+    void ScanPostings(uint64_t first, uint64_t last) {
+      std::unordered_map<uint64_t, std::vector<uint64_t>> postings;
+
+      for (auto i = first; i < std::min<uint64_t>(last, count_); i++) {
+        postings[entries_[i].nameHash].push_back(i);
+      }
+
+      for (auto& [nameHash, positions] : postings) {
+        const auto& scanned = scannedPositions_.emplace_back(std::move(positions));
+
+        postings_[nameHash].push_back({ scanned.data(), scanned.size() });
+      }
+    }
+
+    const uint8_t* capture_ = nullptr;
+    size_t captureSize_ = 0;
+    const uint8_t* index_ = nullptr;
+    size_t indexSize_ = 0;
+    const CaptureIndexEntry* entries_ = nullptr;
+    size_t count_ = 0;
+    std::vector<CaptureIndexEntry> builtEntries_;
+
+    // Sorted positions of the messages of one contract name.
+    struct PostingsBlock {
+      const uint64_t* positions;
+      size_t count;
+    };
+
+    const uint8_t* postingsFile_ = nullptr;
+    size_t postingsSize_ = 0;
+    std::unordered_map<uint64_t, std::vector<PostingsBlock>> postings_; // By name hash, sorted by position.
+    std::deque<std::vector<uint64_t>> scannedPositions_;
+  };
+}
@@ -0,0 +1,400 @@
+// Shared-memory ring buffer transport for 'SERIALIZATION_CONTRACT' messages between processes on the same host (Linux).
+
+#pragma once
+
+#include "SerializationContract.h"
+
+#include <atomic>
+#include <new>
+#include <utility>
+#include <thread>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace SerializationContract {
+  inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  inline void FutexWait(std::atomic<uint32_t>* addr, uint32_t value) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, value, nullptr, nullptr, 0);
+  }
+
+  inline void FutexWake(std::atomic<uint32_t>* addr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+  }
+
+  //
+  // ShmRing
+  //
+  // Bounded ring of fixed size slots in shared memory with one consumer and one (SPSC) or many (MPSC) producers.
+  // The consumer reads messages in place, the slot is released after the callback returns.
+  // The consumer spins 'SpinCount' times for a message, and then blocks on a futex until a producer wakes it.
+  //
+  template <bool IsMultiProducer>
+  class ShmRing {
+  public:
+    static constexpr uint32_t SpinCount = 4096;
+
+    // Creates the ring in a 'memfd' (inherited by child processes, or sent to another process as fd),
+    // or in a named POSIX shared memory object which can be opened with 'Open'.
+    static ShmRing Create(size_t slotCount, size_t slotSize, const char* name = nullptr) {
+      if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0) {
+        throw std::invalid_argument("ShmRing slot count must be a power of 2");
+      }
+
+      int fd = name ? shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600) : memfd_create("SerializationContract", 0);
+      if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "ShmRing create");
+      }
+
+      auto slotStride = SlotStride(slotSize);
+      auto mappingSize = sizeof(Header) + slotCount * slotStride;
+
+      if (ftruncate(fd, mappingSize) != 0) {
+        auto error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "ShmRing create");
+      }
+
+      ShmRing ring(fd, mappingSize);
+
+      auto header = new (ring.mapping_) Header;
+      header->slotCount = slotCount;
+      header->slotSize = slotSize;
+      header->slotStride = slotStride;
+
+      for (size_t i = 0; i < slotCount; i++) {
+        new (ring.SlotAt(i)) Slot;
+        ring.SlotAt(i)->sequence.store(i, std::memory_order_relaxed);
+      }
+
+      header->ready.store(HeaderReady, std::memory_order_release);
+
+      return ring;
+    }
+
+    // Attaches to a ring created by another process, 'fd' is duplicated.
+    static ShmRing Attach(int fd) {
+      int dupFd = dup(fd);
+      if (dupFd < 0) {
+        throw std::system_error(errno, std::generic_category(), "ShmRing attach");
+      }
+
+      return FromFd(dupFd);
+    }
+
+    static ShmRing Open(const char* name) {
+      int fd = shm_open(name, O_RDWR, 0600);
+      if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "ShmRing open");
+      }
+
+      return FromFd(fd);
+    }
+
+    static void Unlink(const char* name) {
+      shm_unlink(name);
+    }
+
+    ShmRing(ShmRing&& ring) noexcept
+      : fd_(std::exchange(ring.fd_, -1)), mapping_(std::exchange(ring.mapping_, nullptr)), mappingSize_(ring.mappingSize_)
+    {}
+
+    ShmRing& operator = (ShmRing&& ring) noexcept {
+      std::swap(fd_, ring.fd_);
+      std::swap(mapping_, ring.mapping_);
+      std::swap(mappingSize_, ring.mappingSize_);
+      return *this;
+    }
+
+    ~ShmRing() {
+      if (mapping_) {
+        munmap(mapping_, mappingSize_);
+      }
+
+      if (fd_ >= 0) {
+        close(fd_);
+      }
+    }
+
+    int Fd() const { return fd_; }
+
+    size_t SlotSize() const { return Hdr()->slotSize; }
+
+    //
+    // Producer
+    //
+    bool TryPush(const uint8_t* data, size_t size) {
+      if (size > Hdr()->slotSize) {
+        throw std::length_error("ShmRing message is larger than slot");
+      }
+
+      return TryWrite([&](uint8_t* slotData, size_t) {
+        memcpy(slotData, data, size);
+        return size;
+      });
+    }
+
+    // Serializes a contract in place in the slot, i.e. 'ring.TryPush(XYZ(par1, par2))'.
+    // If it is larger than the slot, an empty message is published, and 'std::length_error' is thrown.
+    template <typename TupleWithParamsProxy>
+    bool TryPush(TupleWithParamsProxy&& proxy) {
+      return TryWrite([&](uint8_t* slotData, size_t slotSize) {
+        Serializer serializer(slotData, slotSize);
+        proxy >> serializer;
+
+        return serializer.Size();
+      });
+    }
+
+    // Waits while the ring is full.
+    void Push(const uint8_t* data, size_t size) {
+      for (uint32_t spin = 0; !TryPush(data, size); spin++) {
+        Backoff(spin);
+      }
+    }
+
+    template <typename TupleWithParamsProxy>
+    void Push(TupleWithParamsProxy&& proxy) {
+      for (uint32_t spin = 0; !TryPush(proxy); spin++) {
+        Backoff(spin);
+      }
+    }
+
+    //
+    // Consumer
+    //
+    // 'f(const uint8_t* data, size_t size)' is called on the slot in place.
+    template <typename F>
+    bool TryPop(F f) {
+      auto header = Hdr();
+      auto pos = header->tail.load(std::memory_order_relaxed);
+      auto slot = SlotAt(pos & (header->slotCount - 1));
+
+      if (slot->sequence.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+      }
+
+      // The slot is released even if 'f' throws, otherwise the ring would stall.
+      struct Release {
+        ~Release() {
+          slot->sequence.store(pos + header->slotCount, std::memory_order_release);
+          header->tail.store(pos + 1, std::memory_order_relaxed);
+        }
+
+        Header* header;
+        Slot* slot;
+        uint64_t pos;
+      } release{header, slot, pos};
+
+      // The size is written by another process, so it is limited to the slot.
+      f(static_cast<const uint8_t*>(SlotData(slot)), (size_t)std::min(slot->size, header->slotSize));
+
+      return true;
+    }
+
+    // Spins, then blocks until a message arrives.
+    template <typename F>
+    void Pop(F f) {
+      auto header = Hdr();
+
+      for (uint32_t spin = 0; spin < SpinCount; spin++) {
+        if (TryPop(f)) {
+          return;
+        }
+
+        CpuRelax();
+      }
+
+      for (;;) {
+        auto signal = header->signal.load(std::memory_order_acquire);
+
+        header->waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (TryPop(f)) {
+          header->waiting.store(0, std::memory_order_relaxed);
+          return;
+        }
+
+        FutexWait(&header->signal, signal);
+      }
+    }
+
+    // Unserializes the next message in place and dispatches it to 'ON_SERIALIZATION_CONTRACT', returns 'true' if it was delivered to a subscriber.
+    bool Dispatch() {
+      bool dispatched = false;
+
+      Pop([&](const uint8_t* data, size_t size) {
+        dispatched = UnserializeDispatcher::Instance().Dispatch(data, size);
+      });
+
+      return dispatched;
+    }
+
+  private:
+    static constexpr uint32_t HeaderReady = 0x53424352;
+
+    struct Header {
+      alignas(64) std::atomic<uint64_t> head{0};
+      alignas(64) std::atomic<uint64_t> tail{0};
+      alignas(64) std::atomic<uint32_t> signal{0};
+      std::atomic<uint32_t> waiting{0};
+      std::atomic<uint32_t> ready{0};
+      uint64_t slotCount = 0;
+      uint64_t slotSize = 0;
+      uint64_t slotStride = 0;
+    };
+
+    struct Slot {
+      std::atomic<uint64_t> sequence{0};
+      uint64_t size = 0;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+      "ShmRing requires lock free atomics in shared memory");
+
+    ShmRing(int fd, size_t mappingSize)
+      : fd_(fd), mappingSize_(mappingSize)
+    {
+      mapping_ = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mapping_ == MAP_FAILED) {
+        auto error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "ShmRing mmap");
+      }
+    }
+
+    static ShmRing FromFd(int fd) {
+      struct stat st;
+      if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        close(fd);
+        throw std::invalid_argument("ShmRing is not initialized");
+      }
+
+      ShmRing ring(fd, st.st_size);
+
+      auto header = ring.Hdr();
+
+      if (header->ready.load(std::memory_order_acquire) != HeaderReady) {
+        throw std::invalid_argument("ShmRing is not initialized");
+      }
+
+      // The header is written by another process, the slots must fit in the mapping.
+      auto slotCount = header->slotCount;
+      auto mappingSize = (size_t)st.st_size;
+
+      if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 ||
+          header->slotSize > mappingSize || header->slotStride != SlotStride(header->slotSize) ||
+          slotCount > (mappingSize - sizeof(Header)) / header->slotStride) {
+        throw std::invalid_argument("ShmRing header is inconsistent with its size");
+      }
+
+      return ring;
+    }
+
+    // Claims a slot, 'write(data, capacity)' returns the size of the message written to it, and the slot is published.
+    template <typename F>
+    bool TryWrite(F write) {
+      auto header = Hdr();
+      auto pos = header->head.load(std::memory_order_relaxed);
+
+      for (;;) {
+        auto slot = SlotAt(pos & (header->slotCount - 1));
+        auto diff = (int64_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+
+        if (diff < 0) {
+          return false;
+        }
+
+        if (diff > 0) {
+          pos = header->head.load(std::memory_order_relaxed);
+          continue;
+        }
+
+        if constexpr (IsMultiProducer) {
+          if (!header->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            continue;
+          }
+        } else {
+          header->head.store(pos + 1, std::memory_order_relaxed);
+        }
+
+        size_t size = 0;
+
+        try {
+          size = write(static_cast<uint8_t*>(SlotData(slot)), header->slotSize);
+        } catch (...) {
+          // The claimed slot is published empty, otherwise the consumer would wait for it forever.
+          Publish(slot, pos, 0);
+          throw;
+        }
+
+        Publish(slot, pos, size);
+
+        return true;
+      }
+    }
+
+    void Publish(Slot* slot, uint64_t pos, size_t size) {
+      slot->size = size;
+      slot->sequence.store(pos + 1, std::memory_order_release);
+
+      Notify();
+    }
+
+    static void Backoff(uint32_t spin) {
+      if (spin < SpinCount) {
+        CpuRelax();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    static size_t SlotStride(size_t slotSize) {
+      return (sizeof(Slot) + slotSize + 63) & ~size_t(63);
+    }
+
+    Header* Hdr() const {
+      return static_cast<Header*>(mapping_);
+    }
+
+    Slot* SlotAt(size_t index) const {
+      return reinterpret_cast<Slot*>(static_cast<uint8_t*>(mapping_) + sizeof(Header) + index * Hdr()->slotStride);
+    }
+
+    static void* SlotData(Slot* slot) {
+      return slot + 1;
+    }
+
+    void Notify() {
+      auto header = Hdr();
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (header->waiting.load(std::memory_order_relaxed)) {
+        header->signal.fetch_add(1, std::memory_order_release);
+        FutexWake(&header->signal);
+      }
+    }
+
+    int fd_ = -1;
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+  };
+
+  using ShmRingSPSC = ShmRing<false>;
+  using ShmRingMPSC = ShmRing<true>;
+}
@@ -0,0 +1,413 @@
+// Unix-domain socket transport for 'SERIALIZATION_CONTRACT' messages: an epoll server loop and a client (Linux).
+
+#pragma once
+
+#include "SerializationContract.h"
+
+#include <atomic>
+#include <utility>
+#include <system_error>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace SerializationContract {
+  // Each message on the stream is prefixed with its size.
+  using frame_size_t = uint64_t;
+
+  inline sockaddr_un UnixSocketAddress(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path)) {
+      throw std::system_error(ENAMETOOLONG, std::generic_category(), "Unix socket path");
+    }
+
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    return address;
+  }
+
+  //
+  // UnixSocketServer
+  //
+  // Accepts connections and dispatches received messages to 'ON_SERIALIZATION_CONTRACT' on the thread calling 'Run'.
+  // One read may contain many messages, all complete messages in the connection buffer are dispatched before the next read.
+  // The handlers run synchronously, so a slow handler stops reading, the socket buffer fills up, and the client's send waits.
+  // A connection which sends a message larger than 'MaxFrameSize' is closed.
+  // When the process is out of file descriptors, a pending connection is accepted with a reserved descriptor and closed.
+  //
+  class UnixSocketServer {
+  public:
+    static constexpr size_t ReceiveBufferSize = 64 * 1024;
+    static constexpr frame_size_t MaxFrameSize = 64 * 1024 * 1024;
+    static constexpr int MaxEvents = 64;
+
+    UnixSocketServer(const std::string& path)
+      : path_(path)
+    {
+      auto address = UnixSocketAddress(path);
+
+      try {
+        listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        reserveFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+        if (listenFd_ < 0 || epollFd_ < 0 || stopFd_ < 0 || reserveFd_ < 0) {
+          Throw("UnixSocketServer create");
+        }
+
+        unlink(path.c_str());
+
+        if (bind(listenFd_, (sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd_, SOMAXCONN) != 0) {
+          Throw("UnixSocketServer bind");
+        }
+
+        Watch(listenFd_, nullptr);
+        Watch(stopFd_, &stopFd_);
+      } catch (...) {
+        Close();
+        throw;
+      }
+    }
+
+    UnixSocketServer(const UnixSocketServer&) = delete;
+    UnixSocketServer& operator = (const UnixSocketServer&) = delete;
+
+    ~UnixSocketServer() {
+      for (auto& connection : connections_) {
+        close(connection->fd);
+      }
+
+      Close();
+
+      unlink(path_.c_str());
+    }
+
+    // Runs until 'Stop' is called (it can be called from another thread, or from a handler).
+    void Run() {
+      stopped_ = false;
+
+      while (!stopped_) {
+        RunOnce(-1);
+      }
+    }
+
+    void Stop() {
+      stopped_ = true;
+
+      uint64_t one = 1;
+      [[maybe_unused]] auto res = write(stopFd_, &one, sizeof(one));
+    }
+
+    // Waits for events up to 'timeoutMs' (-1 is infinite), returns number of messages delivered to a subscriber.
+    size_t RunOnce(int timeoutMs) {
+      epoll_event events[MaxEvents];
+
+      int count = epoll_wait(epollFd_, events, MaxEvents, timeoutMs);
+      if (count < 0 && errno != EINTR) {
+        Throw("UnixSocketServer epoll_wait");
+      }
+
+      size_t dispatched = 0;
+
+      for (int i = 0; i < count; i++) {
+        auto ptr = events[i].data.ptr;
+
+        if (ptr == nullptr) {
+          Accept();
+        } else if (ptr == &stopFd_) {
+          uint64_t value;
+          [[maybe_unused]] auto res = read(stopFd_, &value, sizeof(value));
+        } else {
+          auto connection = static_cast<Connection*>(ptr);
+
+          if (!Receive(*connection, dispatched)) {
+            CloseConnection(connection);
+          }
+        }
+      }
+
+      return dispatched;
+    }
+
+    size_t ConnectionCount() const {
+      return connections_.size();
+    }
+
+  private:
+    struct Connection {
+      int fd;
+      bytes_t buffer;
+      size_t begin = 0;
+      size_t end = 0;
+    };
+
+    [[noreturn]] static void Throw(const char* what) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void Close() {
+      for (auto fd : { listenFd_, epollFd_, stopFd_, reserveFd_ }) {
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+    }
+
+    void Watch(int fd, void* ptr) {
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.ptr = ptr;
+
+      if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        Throw("UnixSocketServer epoll_ctl");
+      }
+    }
+
+    void Accept() {
+      for (;;) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+          if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+          }
+
+          // Otherwise the pending connection stays in the backlog, and the listening socket is reported ready again and again.
+          if ((errno == EMFILE || errno == ENFILE) && reserveFd_ >= 0 && RejectWithReserveFd()) {
+            continue;
+          }
+
+          return;
+        }
+
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->buffer.resize(ReceiveBufferSize);
+
+        Watch(fd, connection.get());
+
+        connections_.push_back(std::move(connection));
+      }
+    }
+
+    // Accepts and closes a pending connection, returns 'false' if there is none.
+    bool RejectWithReserveFd() {
+      close(reserveFd_);
+
+      int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        close(fd);
+      }
+
+      reserveFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+      return fd >= 0;
+    }
+
+    void CloseConnection(Connection* connection) {
+      epoll_ctl(epollFd_, EPOLL_CTL_DEL, connection->fd, nullptr);
+      close(connection->fd);
+
+      auto it = std::find_if(connections_.begin(), connections_.end(), [&](const auto& p) { return p.get() == connection; });
+      connections_.erase(it);
+    }
+
+    // Reads once, and dispatches all complete messages. Returns 'false' when the connection is closed, or sent a too large message.
+    bool Receive(Connection& connection, size_t& dispatched) {
+      auto& buffer = connection.buffer;
+
+      // Moves a partial message to the beginning of the buffer, or grows the buffer for a message larger than it.
+      if (connection.end == buffer.size()) {
+        auto pending = connection.end - connection.begin;
+
+        if (connection.begin > 0) {
+          memmove(buffer.data(), buffer.data() + connection.begin, pending);
+          connection.begin = 0;
+          connection.end = pending;
+        } else {
+          buffer.resize(buffer.size() * 2);
+        }
+      }
+
+      auto res = read(connection.fd, buffer.data() + connection.end, buffer.size() - connection.end);
+      if (res <= 0) {
+        return res < 0 && (errno == EAGAIN || errno == EINTR);
+      }
+
+      connection.end += res;
+
+      while (connection.end - connection.begin >= sizeof(frame_size_t)) {
+        frame_size_t size;
+        memcpy(&size, buffer.data() + connection.begin, sizeof(size));
+
+        if (size > MaxFrameSize) {
+          return false;
+        }
+
+        auto frameSize = sizeof(frame_size_t) + size;
+
+        if (connection.end - connection.begin < frameSize) {
+          if (frameSize > buffer.size()) {
+            memmove(buffer.data(), buffer.data() + connection.begin, connection.end - connection.begin);
+            connection.end -= connection.begin;
+            connection.begin = 0;
+
+            buffer.resize(frameSize);
+          }
+
+          break;
+        }
+
+        if (UnserializeDispatcher::Instance().Dispatch(buffer.data() + connection.begin + sizeof(frame_size_t), size)) {
+          dispatched++;
+        }
+
+        connection.begin += frameSize;
+      }
+
+      if (connection.begin == connection.end) {
+        connection.begin = connection.end = 0;
+      }
+
+      return true;
+    }
+
+    std::string path_;
+    int listenFd_ = -1;
+    int epollFd_ = -1;
+    int stopFd_ = -1;
+    int reserveFd_ = -1;
+    std::atomic<bool> stopped_ = false;
+    std::vector<std::unique_ptr<Connection>> connections_;
+  };
+
+  //
+  // UnixSocketClient
+  //
+  // 'Send' queues serialized messages, which are written with one 'sendmsg' by 'Flush', or when the batch is full.
+  // A closed server is reported by 'Flush' as 'EPIPE', without 'SIGPIPE'.
+  //
+  class UnixSocketClient {
+  public:
+    static constexpr size_t MaxBatchMessages = 64;
+    static constexpr size_t MaxBatchBytes = 64 * 1024;
+
+    UnixSocketClient(const std::string& path) {
+      auto address = UnixSocketAddress(path);
+
+      fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "UnixSocketClient create");
+      }
+
+      if (connect(fd_, (sockaddr*)&address, sizeof(address)) != 0) {
+        auto error = errno;
+        close(fd_);
+        throw std::system_error(error, std::generic_category(), "UnixSocketClient connect");
+      }
+
+      batch_.resize(MaxBatchMessages);
+    }
+
+    UnixSocketClient(const UnixSocketClient&) = delete;
+    UnixSocketClient& operator = (const UnixSocketClient&) = delete;
+
+    // Queued messages are flushed, errors are ignored (call 'Flush' to handle them).
+    ~UnixSocketClient() {
+      try {
+        Flush();
+      } catch (...) {
+      }
+
+      close(fd_);
+    }
+
+    // Serializes a contract, i.e. 'client.Send(XYZ(par1, par2))'.
+    // Throws 'std::length_error' if it is larger than 'UnixSocketServer::MaxFrameSize', which the server would reject.
+    template <typename TupleWithParamsProxy>
+    void Send(TupleWithParamsProxy&& proxy) {
+      auto& message = batch_[batchCount_];
+      proxy >> message.bytes;
+
+      if (message.bytes.size() > UnixSocketServer::MaxFrameSize) {
+        message.bytes = bytes_t();
+        throw std::length_error("UnixSocketClient message is larger than MaxFrameSize");
+      }
+
+      batchCount_++;
+
+      message.size = message.bytes.size();
+      batchBytes_ += sizeof(frame_size_t) + message.size;
+
+      if (batchCount_ == MaxBatchMessages || batchBytes_ >= MaxBatchBytes) {
+        Flush();
+      }
+    }
+
+    void Flush() {
+      iovec iov[MaxBatchMessages * 2];
+
+      for (size_t i = 0; i < batchCount_; i++) {
+        iov[2 * i] = { &batch_[i].size, sizeof(frame_size_t) };
+        iov[2 * i + 1] = { batch_[i].bytes.data(), batch_[i].bytes.size() };
+      }
+
+      size_t iovIndex = 0;
+      size_t iovCount = batchCount_ * 2;
+
+      while (iovIndex < iovCount) {
+        msghdr message = {};
+        message.msg_iov = iov + iovIndex;
+        message.msg_iovlen = std::min<size_t>(iovCount - iovIndex, IOV_MAX);
+
+        auto res = sendmsg(fd_, &message, MSG_NOSIGNAL);
+        if (res < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+
+          auto error = errno;
+          batchCount_ = 0;
+          batchBytes_ = 0;
+
+          throw std::system_error(error, std::generic_category(), "UnixSocketClient sendmsg");
+        }
+
+        // Skips written buffers after a partial write.
+        size_t written = res;
+
+        while (iovIndex < iovCount && written >= iov[iovIndex].iov_len) {
+          written -= iov[iovIndex].iov_len;
+          iovIndex++;
+        }
+
+        if (iovIndex < iovCount) {
+          iov[iovIndex].iov_base = static_cast<uint8_t*>(iov[iovIndex].iov_base) + written;
+          iov[iovIndex].iov_len -= written;
+        }
+      }
+
+      batchCount_ = 0;
+      batchBytes_ = 0;
+    }
+
+  private:
+    struct Message {
+      frame_size_t size;
+      bytes_t bytes;
+    };
+
+    int fd_ = -1;
+    std::vector<Message> batch_;
+    size_t batchCount_ = 0;
+    size_t batchBytes_ = 0;
+  };
+}
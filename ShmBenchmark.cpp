@@ -0,0 +1,82 @@
+// Latency benchmark for 'ShmRingSPSC': a contract is sent to a child process, which sends it back through a second ring.
+// Reports round trip percentiles, and one way latency (half of the round trip).
+//
+// g++ -std=c++17 -O2 -pthread ShmBenchmark.cpp -o ShmBenchmark
+// ./ShmBenchmark [messages]
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include "SerializationContractShm.h"
+
+SERIALIZATION_CONTRACT(Ping, int, double);
+SERIALIZATION_CONTRACT(Pong, int, double);
+
+int main(int argc, char** argv) {
+  size_t messages = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+  auto pingRing = SerializationContract::ShmRingSPSC::Create(64, 256);
+  auto pongRing = SerializationContract::ShmRingSPSC::Create(64, 256);
+
+  if (fork() == 0) {
+    // Echo process, stops on a negative id.
+    bool stopped = false;
+
+    ON_SERIALIZATION_CONTRACT(Ping)[&](int id, double price)
+    {
+      pongRing.Push(Pong(id, price));
+
+      stopped = id < 0;
+    };
+
+    while (!stopped) {
+      pingRing.Dispatch();
+    }
+
+    _exit(0);
+  }
+
+  int received = -1;
+  ON_SERIALIZATION_CONTRACT(Pong)[&](int id, double)
+  {
+    received = id;
+  };
+
+  std::vector<double> roundTrips(messages);
+
+  for (size_t i = 0; i < messages; i++) {
+    int id = (int)(i & INT32_MAX);
+    double price = i * 0.5;
+
+    auto start = std::chrono::steady_clock::now();
+
+    pingRing.Push(Ping(id, price));
+    pongRing.Dispatch();
+
+    roundTrips[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    if (received != id) {
+      std::cerr << "unexpected reply\n";
+      return 1;
+    }
+  }
+
+  int stop = -1;
+  double price = 0;
+  pingRing.Push(Ping(stop, price));
+  pongRing.Dispatch();
+
+  int status;
+  wait(&status);
+
+  std::sort(roundTrips.begin(), roundTrips.end());
+
+  auto percentile = [&](double p) { return roundTrips[(size_t)(p * (messages - 1))]; };
+
+  std::cout << "messages: " << messages << "\n";
+  std::cout << "round trip ns, p50: " << percentile(0.5) << ", p99: " << percentile(0.99) << ", p99.9: " << percentile(0.999) << "\n";
+  std::cout << "one way ns, p50: " << percentile(0.5) / 2 << "\n";
+}
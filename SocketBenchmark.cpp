@@ -0,0 +1,74 @@
+// Load generator for 'UnixSocketServer': client threads send contracts, the server dispatches them on one thread.
+// Reports messages per second, and messages per second per core (per second of CPU time of all threads).
+//
+// g++ -std=c++17 -O2 -pthread SocketBenchmark.cpp -o SocketBenchmark
+// ./SocketBenchmark [clients] [messages per client]
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "SerializationContractSocket.h"
+
+SERIALIZATION_CONTRACT(Order, int, std::string, double);
+
+static double CpuSeconds() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char** argv) {
+  int clients = argc > 1 ? std::stoi(argv[1]) : 2;
+  size_t messages = argc > 2 ? std::stoul(argv[2]) : 1000000;
+
+  auto path = "/tmp/SocketBenchmark." + std::to_string(getpid()) + ".sock";
+
+  SerializationContract::UnixSocketServer server(path);
+
+  size_t received = 0;
+  ON_SERIALIZATION_CONTRACT(Order)[&](int, const std::string&, double)
+  {
+    if (++received == clients * messages) {
+      server.Stop();
+    }
+  };
+
+  auto cpuStart = CpuSeconds();
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+
+  for (int c = 0; c < clients; c++) {
+    threads.emplace_back([&, c]() {
+      SerializationContract::UnixSocketClient client(path);
+
+      std::string symbol = "SYM" + std::to_string(c);
+
+      for (size_t i = 0; i < messages; i++) {
+        int id = (int)i;
+        double price = i * 0.5;
+
+        client.Send(Order(id, symbol, price));
+      }
+
+      client.Flush();
+    });
+  }
+
+  server.Run();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  auto cpuSeconds = CpuSeconds() - cpuStart;
+
+  std::cout << "clients: " << clients << ", messages: " << received << "\n";
+  std::cout << "messages/s: " << received / seconds << "\n";
+  std::cout << "messages/s per core: " << received / cpuSeconds << "\n";
+}